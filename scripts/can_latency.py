@@ -0,0 +1,62 @@
+# Collect CAN request -> response latency statistics from boards built with
+# -DCONFIG_CAN_LATENCY_TRACE=1 and -DCONFIG_SHELL=1.
+#
+# Usage: python3 scripts/can_latency.py GarageDoorController=/dev/ttyACM0 \
+#            HeatingController=/dev/ttyUSB0 --duration 60
+#
+# Statistics are reset when the script starts, the gateway (or any CAN tool)
+# is expected to send CANIOT commands/attribute reads during the window.
+
+import argparse
+import re
+import time
+
+import serial
+
+BAUDRATE = 500000
+PATTERN = re.compile(
+    r"lat n=(\d+) p50<=(\d+) p99<=(\d+) max=(\d+) ovf=(\d+)"
+)
+
+
+def dump(ser: serial.Serial, timeout: float = 2.0):
+    ser.reset_input_buffer()
+    ser.write(b"b")
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        line = ser.readline().decode(errors="ignore")
+        m = PATTERN.search(line)
+        if m:
+            return tuple(int(v) for v in m.groups())
+    return None
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("boards", nargs="+", help="ENV=PORT")
+    parser.add_argument("--duration", type=float, default=30.0)
+    parser.add_argument("--f-cpu", type=int, default=16000000)
+    args = parser.parse_args()
+
+    boards = dict(b.split("=", 1) for b in args.boards)
+    ports = {env: serial.Serial(port, BAUDRATE, timeout=0.2) for env, port in boards.items()}
+
+    for ser in ports.values():
+        dump(ser)  # reset statistics
+
+    time.sleep(args.duration)
+
+    us = lambda cycles: cycles * 1e6 / args.f_cpu
+
+    print("env,count,p50_cycles,p99_cycles,max_cycles,overflows,p50_us,p99_us,max_us")
+    for env, ser in ports.items():
+        res = dump(ser)
+        if res is None:
+            print(f"{env},error")
+            continue
+        n, p50, p99, mx, ovf = res
+        print(f"{env},{n},{p50},{p99},{mx},{ovf},{us(p50):.0f},{us(p99):.0f},{us(mx):.0f}")
+
+
+if __name__ == "__main__":
+    main()
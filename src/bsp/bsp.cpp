@@ -280,7 +280,7 @@ int bsp_descr_gpio_pin_init(pin_descr_t descr, uint8_t direction, uint8_t state)
     return ret;
 }
 
-int bsp_descr_gpio_output_write(pin_descr_t descr, uint8_t state)
+int z_bsp_descr_gpio_output_write(pin_descr_t descr, uint8_t state)
 {
     int ret;
     struct pin pin;
@@ -294,7 +294,7 @@ int bsp_descr_gpio_output_write(pin_descr_t descr, uint8_t state)
     return 0;
 }
 
-int bsp_descr_gpio_toggle(pin_descr_t descr)
+int z_bsp_descr_gpio_toggle(pin_descr_t descr)
 {
     int ret;
     struct pin pin;
@@ -308,7 +308,7 @@ int bsp_descr_gpio_toggle(pin_descr_t descr)
     return 0;
 }
 
-uint8_t bsp_descr_gpio_input_read(pin_descr_t descr)
+uint8_t z_bsp_descr_gpio_input_read(pin_descr_t descr)
 {
     int ret;
     struct pin pin;
@@ -334,6 +334,37 @@ void bsp_descr_gpio_set_direction(pin_descr_t descr, uint8_t direction)
     }
 }
 
+uint8_t z_bsp_descr_gpio_port_read(pin_descr_t descr)
+{
+    int ret;
+    struct pin pin;
+
+    ret = get_pin_from_descr(descr, &pin);
+
+    if (ret == 0) {
+        if (BSP_GPIO_PIN_TYPE_GET(pin.pin) == BSP_GPIO_PIN_TYPE_GPIO) {
+            return ((GPIO_Device *)pin.dev)->PIN;
+#if CONFIG_EXTIO_ENABLED
+        } else {
+            __ASSERT_THREAD_CONTEXT();
+
+            return bsp_extio_read_state((struct extio_device *)pin.dev);
+#endif
+        }
+    }
+
+    return 0u;
+}
+
+void bsp_gpio_commit(void)
+{
+#if CONFIG_EXTIO_ENABLED
+    for (uint8_t i = 0u; i < CONFIG_EXTIO_DEVICES_COUNT; i++) {
+        bsp_extio_commit(EXTIO_DEVICE(i));
+    }
+#endif
+}
+
 void bsp_pin_pci_set_enabled(uint8_t descr, uint8_t state)
 {
     const uint8_t pci_group = BSP_GPIO_PCINT_DESCR_GROUP(descr);
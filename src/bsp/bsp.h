@@ -340,6 +340,26 @@ void bsp_pin_set_direction(struct pin *pin, uint8_t direction);
  */
 int bsp_descr_gpio_pin_init(pin_descr_t descr, uint8_t direction, uint8_t state);
 
+/* Runtime implementations, use the bsp_descr_gpio_*() wrappers below */
+int z_bsp_descr_gpio_output_write(pin_descr_t descr, uint8_t state);
+int z_bsp_descr_gpio_toggle(pin_descr_t descr);
+uint8_t z_bsp_descr_gpio_input_read(pin_descr_t descr);
+uint8_t z_bsp_descr_gpio_port_read(pin_descr_t descr);
+
+/**
+ * @brief Tell whether a descriptor is an active pin of a native GPIO port
+ */
+#define BSP_DESCR_IS_NATIVE_GPIO(_descr)                                                 \
+    ((BSP_DESCR_STATUS_GET(_descr) == BSP_DESCR_ACTIVE) &&                               \
+     (BSP_DESCR_DRIVER_GET(_descr) == BSP_DESCR_DRIVER_GPIO))
+
+/* Descriptors known at compile time and referring to a native GPIO are
+ * resolved to direct port register accesses (sbi/cbi/in), other descriptors
+ * go through the runtime implementation.
+ */
+#define BSP_DESCR_FAST_PATH(_descr)                                                      \
+    (__builtin_constant_p(_descr) && BSP_DESCR_IS_NATIVE_GPIO(_descr))
+
 /**
  * @brief Write a pin from a pin descriptor.
  *
@@ -347,7 +367,23 @@ int bsp_descr_gpio_pin_init(pin_descr_t descr, uint8_t direction, uint8_t state)
  * @param state 1 for high, 0 for low
  * @return int
  */
-int bsp_descr_gpio_output_write(pin_descr_t descr, uint8_t state);
+__attribute__((always_inline)) static inline int
+bsp_descr_gpio_output_write(pin_descr_t descr, uint8_t state)
+{
+    if (BSP_DESCR_FAST_PATH(descr)) {
+        GPIO_Device *const gpio = BSP_DESCR_DEVICE_GET(descr);
+
+        if (state) {
+            gpio->PORT |= _BV(BSP_DESCR_GPIO_PIN_GET(descr));
+        } else {
+            gpio->PORT &= ~_BV(BSP_DESCR_GPIO_PIN_GET(descr));
+        }
+
+        return 0;
+    }
+
+    return z_bsp_descr_gpio_output_write(descr, state);
+}
 
 /**
  * @brief Toggle a pin from a pin descriptor.
@@ -355,7 +391,17 @@ int bsp_descr_gpio_output_write(pin_descr_t descr, uint8_t state);
  * @param descr
  * @return int
  */
-int bsp_descr_gpio_toggle(pin_descr_t descr);
+__attribute__((always_inline)) static inline int bsp_descr_gpio_toggle(pin_descr_t descr)
+{
+    if (BSP_DESCR_FAST_PATH(descr)) {
+        /* Writing a one to PINxn toggles PORTxn */
+        BSP_DESCR_DEVICE_GET(descr)->PIN = _BV(BSP_DESCR_GPIO_PIN_GET(descr));
+
+        return 0;
+    }
+
+    return z_bsp_descr_gpio_toggle(descr);
+}
 
 /**
  * @brief Read input pin from descriptor
@@ -363,7 +409,15 @@ int bsp_descr_gpio_toggle(pin_descr_t descr);
  * @param pin
  * @return uint8_t 1 if high, 0 if low
  */
-uint8_t bsp_descr_gpio_input_read(pin_descr_t descr);
+__attribute__((always_inline)) static inline uint8_t
+bsp_descr_gpio_input_read(pin_descr_t descr)
+{
+    if (BSP_DESCR_FAST_PATH(descr)) {
+        return (BSP_DESCR_DEVICE_GET(descr)->PIN >> BSP_DESCR_GPIO_PIN_GET(descr)) & 1u;
+    }
+
+    return z_bsp_descr_gpio_input_read(descr);
+}
 
 /**
  * @brief Set pin direction for a pin descriptor.
@@ -373,6 +427,39 @@ uint8_t bsp_descr_gpio_input_read(pin_descr_t descr);
  */
 void bsp_descr_gpio_set_direction(pin_descr_t descr, uint8_t direction);
 
+/**
+ * @brief Read all the pins of the port (GPIO port or extended IO device) the
+ * descriptor belongs to, in a single access (e.g. one I2C transaction for the
+ * PCF8574).
+ *
+ * @param descr Descriptor of any pin of the port
+ * @return uint8_t Port state, bit n being the state of pin n, 0 if the
+ * descriptor is not active
+ */
+__attribute__((always_inline)) static inline uint8_t
+bsp_descr_gpio_port_read(pin_descr_t descr)
+{
+    if (BSP_DESCR_FAST_PATH(descr)) {
+        return BSP_DESCR_DEVICE_GET(descr)->PIN;
+    }
+
+    return z_bsp_descr_gpio_port_read(descr);
+}
+
+/**
+ * @brief Extract the state of a pin from the port state returned by
+ * bsp_descr_gpio_port_read()
+ */
+#define BSP_DESCR_PORT_PIN_STATE(_port, _descr)                                         \
+    (((_port) >> BSP_DESCR_GPIO_PIN_GET(_descr)) & 1u)
+
+/**
+ * @brief Write the outputs staged since the last commit to the extended IO
+ * devices, outputs written together switch in a single transaction.
+ * Staged outputs are otherwise flushed from the system workqueue.
+ */
+void bsp_gpio_commit(void);
+
 /**
  * @brief Enable or disable PCI for a pin descriptor.
  *
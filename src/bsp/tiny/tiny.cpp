@@ -8,6 +8,8 @@
 
 #include "dev.h"
 #include "devices/pcf8574.h"
+#include "metrics.h"
+#include "onchange.h"
 #include "tiny.h"
 
 #include <stdio.h>
@@ -41,9 +43,50 @@ static struct pcf8574_state pcf_state;
 struct extio_device extio_devices[CONFIG_EXTIO_DEVICES_COUNT] = {{
     .addr   = PCF8574_ADDR,
     .state  = 0u, /* All outputs low */
+    .dirty  = 0u,
     .device = {.p_pcf = &pcf_state},
 }};
 
+#if CONFIG_EXTIO_WRITE_COMBINING
+static void extio_flush_handler(struct k_work *w)
+{
+    bsp_gpio_commit();
+}
+
+static K_WORK_DEFINE(extio_flush_work, extio_flush_handler);
+#endif
+
+#if CONFIG_EXTIO_INPUT_CACHE
+static void extio_poll(struct extio_device *dev)
+{
+    /* Force an actual read */
+    pcf8574_invalidate_buffer(dev->device.p_pcf);
+
+    const uint8_t input   = pcf8574_get(dev->device.p_pcf);
+    const uint8_t changed = input ^ dev->input;
+
+    dev->input = input;
+
+    LOG_DBG("extio: poll x%02x changed x%02x", input, changed);
+
+    if (changed & dev->notify_mask) {
+        onchange_notify();
+    }
+}
+
+static void extio_poll_handler(struct k_work *w)
+{
+    for (uint8_t i = 0u; i < CONFIG_EXTIO_DEVICES_COUNT; i++) {
+        extio_poll(EXTIO_DEVICE(i));
+    }
+
+    /* Let the application see the new state */
+    dev_trigger_process_event(DEV_EVENT_APP);
+}
+
+static K_WORK_DEFINE(extio_poll_work, extio_poll_handler);
+#endif
+
 #if CONFIG_PCF8574_INT_ENABLED
 ISR(BSP_PCF_INT_vect)
 {
@@ -52,11 +95,17 @@ ISR(BSP_PCF_INT_vect)
 #endif
 
     pcf8574_invalidate_buffer(&pcf_state);
+    metrics_inc(METRICS_IRQ_EXTIO);
 
-    int8_t ret = dev_trigger_process();
+#if CONFIG_EXTIO_INPUT_CACHE
+    /* The application is notified once the new state is read */
+    k_system_workqueue_submit(&extio_poll_work);
+#else
+    int8_t ret = dev_trigger_process_event(DEV_EVENT_APP);
 
     /* Immediately yield to schedule main thread */
     if (ret > 0) k_yield_from_isr();
+#endif
 }
 #endif
 #endif
@@ -88,6 +137,11 @@ void bsp_tiny_init(struct extio_device *dev)
      * Set all pins as inputs without pullup.
      */
     bsp_extio_write(dev, 0x00, 0x00);
+    bsp_extio_commit(dev);
+
+#if CONFIG_EXTIO_INPUT_CACHE
+    dev->input = pcf8574_get(dev->device.p_pcf);
+#endif
 
 #if CONFIG_PCF8574_INT_ENABLED
     /* configure PCF interrupt on falling  (active low) */
@@ -101,18 +155,62 @@ void bsp_tiny_init(struct extio_device *dev)
 }
 
 #if CONFIG_PCF8574_ENABLED
-void bsp_extio_set_pin_direction(struct extio_device *dev, uint8_t pin, uint8_t direction)
+static void bsp_extio_flush(struct extio_device *dev)
 {
-    if (direction == GPIO_INPUT) {
-        dev->state |= (1u << pin);
-    }
-
     pcf8574_set(dev->device.p_pcf, dev->state);
+
+#if CONFIG_EXTIO_INPUT_CACHE
+    /* Pins driven low read low, the level of released pins is unknown
+     * until they are read again.
+     */
+    const uint8_t released = dev->state & ~dev->written;
+
+    dev->written = dev->state;
+    dev->input &= dev->state;
+
+    if (released) {
+        k_system_workqueue_submit(&extio_poll_work);
+    }
+#endif
 }
 
 static void bsp_extio_write_state(struct extio_device *dev)
 {
-    pcf8574_set(dev->device.p_pcf, dev->state);
+#if CONFIG_EXTIO_WRITE_COMBINING
+    /* Writes issued until the next scheduling point are combined */
+    dev->dirty = 1u;
+    k_system_workqueue_submit(&extio_flush_work);
+#else
+    bsp_extio_flush(dev);
+#endif
+}
+
+void bsp_extio_commit(struct extio_device *dev)
+{
+#if CONFIG_EXTIO_WRITE_COMBINING
+    if (dev->dirty) {
+        dev->dirty = 0u;
+        bsp_extio_flush(dev);
+    }
+#else
+    (void)dev;
+#endif
+}
+
+#if CONFIG_EXTIO_INPUT_CACHE
+void bsp_extio_set_notify_mask(struct extio_device *dev, uint8_t mask)
+{
+    dev->notify_mask = mask;
+}
+#endif
+
+void bsp_extio_set_pin_direction(struct extio_device *dev, uint8_t pin, uint8_t direction)
+{
+    if (direction == GPIO_INPUT) {
+        dev->state |= (1u << pin);
+    }
+
+    bsp_extio_write_state(dev);
 }
 
 void bsp_extio_write(struct extio_device *dev, uint8_t mask, uint8_t value)
@@ -124,7 +222,14 @@ void bsp_extio_write(struct extio_device *dev, uint8_t mask, uint8_t value)
 
 uint8_t bsp_extio_read_state(struct extio_device *dev)
 {
+    /* Pins configured as inputs must be released before being read */
+    bsp_extio_commit(dev);
+
+#if CONFIG_EXTIO_INPUT_CACHE
+    return dev->input;
+#else
     return pcf8574_get(dev->device.p_pcf);
+#endif
 }
 
 void bsp_extio_write_pin_state(struct extio_device *dev, uint8_t pin, uint8_t state)
@@ -150,7 +255,7 @@ void bsp_extio_toggle_pin(struct extio_device *dev, uint8_t pin)
 uint8_t bsp_extio_read_pin_state(struct extio_device *dev, uint8_t pin)
 {
     const uint8_t r =
-        (pcf8574_get(dev->device.p_pcf) & (1u << pin)) ? GPIO_HIGH : GPIO_LOW;
+        (bsp_extio_read_state(dev) & (1u << pin)) ? GPIO_HIGH : GPIO_LOW;
 
     LOG_DBG("extio: read pin %u state %u", pin, r);
 
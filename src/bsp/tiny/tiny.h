@@ -51,6 +51,20 @@ struct extio_device {
     uint8_t addr;
     uint8_t state;
 
+    /* State has been modified but not written to the device yet */
+    uint8_t dirty;
+
+#if CONFIG_EXTIO_INPUT_CACHE
+    /* Last state written to the device */
+    uint8_t written;
+
+    /* Last state read from the device */
+    uint8_t input;
+
+    /* Pins whose change triggers the board control telemetry */
+    uint8_t notify_mask;
+#endif
+
     union {
         /* Currently only PCF8574 is supported */
         struct pcf8574_state *p_pcf;
@@ -82,6 +96,23 @@ void bsp_extio_toggle_pin(struct extio_device *dev, uint8_t pin);
 
 uint8_t bsp_extio_read_pin_state(struct extio_device *dev, uint8_t pin);
 
+/**
+ * @brief Write the staged state to the device if it has been modified
+ *
+ * @param dev
+ */
+void bsp_extio_commit(struct extio_device *dev);
+
+#if CONFIG_EXTIO_INPUT_CACHE
+/**
+ * @brief Set the pins whose change triggers the board control telemetry
+ *
+ * @param dev
+ * @param mask
+ */
+void bsp_extio_set_notify_mask(struct extio_device *dev, uint8_t mask);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -7,6 +7,8 @@
 #if defined(CONFIG_BOARD_V1)
 
 #include "config.h"
+#include "metrics.h"
+#include "onchange.h"
 #include "v1.h"
 
 #include <stdio.h>
@@ -54,18 +56,14 @@
         (BSP_DESCR_GPIO_PORT_GET_INDEX(BSP_RL1) == GPIOD_INDEX) ||                       \
         (BSP_DESCR_GPIO_PORT_GET_INDEX(BSP_RL2) == GPIOD_INDEX)
 
-extern "C" void dev_trigger_telemetry(caniot_endpoint_t ep);
-
-// TODO: use flags instead to make sure the state is notified
 #if PCINT0_ISR_ENABLED
 ISR(PCINT0_vect)
 {
 #if DEBUG_INT
     serial_transmit('*');
 #endif
-    dev_trigger_telemetry(CANIOT_ENDPOINT_BOARD_CONTROL);
-
-    /* TODO add k_yield_from_isr() */
+    metrics_inc(METRICS_IRQ_PCINT);
+    onchange_notify();
 }
 #endif
 
@@ -75,9 +73,8 @@ ISR(PCINT1_vect)
 #if DEBUG_INT
     serial_transmit('!');
 #endif
-    dev_trigger_telemetry(CANIOT_ENDPOINT_BOARD_CONTROL);
-
-    /* TODO add k_yield_from_isr() */
+    metrics_inc(METRICS_IRQ_PCINT);
+    onchange_notify();
 }
 #endif
 
@@ -87,9 +84,8 @@ ISR(PCINT2_vect)
 #if DEBUG_INT
     serial_transmit('=');
 #endif
-    dev_trigger_telemetry(CANIOT_ENDPOINT_BOARD_CONTROL);
-
-    /* TODO add k_yield_from_isr() */
+    metrics_inc(METRICS_IRQ_PCINT);
+    onchange_notify();
 }
 #endif
 
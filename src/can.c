@@ -7,12 +7,16 @@
 #include "bsp/bsp.h"
 #include "can.h"
 #include "dev.h"
+#include "latency.h"
+#include "metrics.h"
 #include "platform.h"
 
 #include <avrtos/avrtos.h>
 #include <avrtos/logging.h>
 #include <avrtos/devices/mcp2515.h>
 
+#include <util/atomic.h>
+
 #define LOG_LEVEL CONFIG_CAN_LOG_LEVEL
 
 #define K_MODULE_CAN 0x21
@@ -27,12 +31,31 @@
 
 #define CONFIG_CAN_THREAD_OFFLOADED !CONFIG_CAN_WORKQ_OFFLOADED
 
-K_MSGQ_DEFINE(txq, sizeof(struct can_frame), CONFIG_CAN_TX_MSGQ_SIZE);
+/* TX ring, frames are built in place by the producers (see can_txq_alloc()).
+ * Slots are allocated in order but two producers may commit them out of order,
+ * a frame is sent once committed and once all the frames before it are sent.
+ * Every commit wakes up the TX thread (semaphore) or submits the TX work.
+ */
+__STATIC_ASSERT(CONFIG_CAN_TX_MSGQ_SIZE <= 8u, "CONFIG_CAN_TX_MSGQ_SIZE must be <= 8");
+
+static struct can_frame tx_ring[CONFIG_CAN_TX_MSGQ_SIZE];
+static uint8_t tx_head      = 0u;
+static uint8_t tx_tail      = 0u;
+static uint8_t tx_count     = 0u;
+static uint8_t tx_committed = 0u; /* Bitmask of the committed slots */
+static uint8_t tx_retries   = 0u; /* Retries of the frame at the tail (per frame) */
+
+#define TX_RING_NEXT(_i) (((_i) + 1u) < CONFIG_CAN_TX_MSGQ_SIZE ? ((_i) + 1u) : 0u)
 
 #if CONFIG_CAN_WORKQ_OFFLOADED
 static void can_tx_wq_cb(struct k_work *work);
 static K_WORK_DEFINE(can_tx_work, can_tx_wq_cb);
+
+/* Resubmits the TX work after a frame was refused by the controller */
+static struct k_work_delayable can_tx_retry_work = K_WORK_DELAYABLE_INIT(can_tx_wq_cb);
 #else
+K_SEM_DEFINE(tx_sem, 0u, CONFIG_CAN_TX_MSGQ_SIZE);
+
 static void can_tx_entry(void *arg);
 K_THREAD_DEFINE(
     can_tx_thread, can_tx_entry, CONFIG_CAN_THREAD_STACK_SIZE, K_COOPERATIVE, NULL, 'C');
@@ -40,6 +63,165 @@ K_THREAD_DEFINE(
 
 static struct mcp2515_device mcp;
 
+/* RX ring, filled from the MCP2515 receive buffers and read in place through
+ * can_recv_peek(). Only accessed from the thread processing the CANIOT device(s).
+ */
+__STATIC_ASSERT((CONFIG_CAN_RX_RING_SIZE & (CONFIG_CAN_RX_RING_SIZE - 1u)) == 0u,
+                "CONFIG_CAN_RX_RING_SIZE must be a power of 2");
+
+#define RX_RING_MASK (CONFIG_CAN_RX_RING_SIZE - 1u)
+
+static struct can_frame rx_ring[CONFIG_CAN_RX_RING_SIZE];
+static uint8_t rx_head  = 0u;
+static uint8_t rx_count = 0u;
+
+#if CONFIG_CAN_SOFT_FILTERING == 0
+
+/* Acceptance filters plan
+ *
+ * The MCP2515 has 2 masks: RXM0 shared by filters RXF0-1 and RXM1 shared by
+ * filters RXF2-5. RXM1 is an exact match: RXF2 accepts broadcast frames and
+ * RXF3-5 accept up to 3 instances exactly. The other instances are grouped
+ * under RXM0 with the tightest sub-identifier (SID) mask covering them with
+ * 2 filters. Frames accepted for SIDs which are not served are discarded in
+ * software (see multi_caniot_recv()).
+ */
+#define SID_COUNT 8u
+
+struct filters_plan {
+    uint8_t exact;      /* SIDs matched exactly by RXF3-5 (bitmask) */
+    uint8_t group_mask; /* SID bits compared by RXM0 */
+    uint8_t groups[2u]; /* SIDs matched by RXF0-1 (masked) */
+    uint8_t coverage;   /* SIDs accepted by RXM0 (bitmask) */
+};
+
+/* Find the SID mask with the smallest coverage grouping the given SIDs in
+ * at most 2 filters.
+ */
+static void filters_plan_groups(uint8_t sids, struct filters_plan *plan)
+{
+    plan->coverage   = 0xFFu;
+    plan->group_mask = 0u;
+    plan->groups[0u] = 0u;
+    plan->groups[1u] = 0u;
+
+    for (int8_t mask = SID_COUNT - 1u; mask >= 0; mask--) {
+        uint8_t values   = 0u; /* bitmask of masked SID values */
+        uint8_t coverage = 0u;
+
+        for (uint8_t sid = 0u; sid < SID_COUNT; sid++) {
+            if (sids & BIT(sid)) values |= BIT(sid & mask);
+        }
+
+        if (__builtin_popcount(values) > 2u) continue;
+
+        for (uint8_t sid = 0u; sid < SID_COUNT; sid++) {
+            if (values & BIT(sid & mask)) coverage |= BIT(sid);
+        }
+
+        if (__builtin_popcount(coverage) < __builtin_popcount(plan->coverage)) {
+            uint8_t n = 0u;
+
+            plan->coverage   = coverage;
+            plan->group_mask = mask;
+            for (uint8_t v = 0u; v < SID_COUNT; v++) {
+                if (values & BIT(v)) plan->groups[n++] = v;
+            }
+            if (n == 1u) plan->groups[1u] = plan->groups[0u];
+        }
+    }
+}
+
+static void filters_plan_build(uint8_t sids, struct filters_plan *plan)
+{
+    struct filters_plan candidate;
+    uint8_t best_extra = 0xFFu;
+
+    /* Try all sets of up to 3 SIDs to be matched exactly */
+    for (uint16_t exact = 0u; exact < BIT(SID_COUNT); exact++) {
+        if ((exact & ~sids) || (__builtin_popcount(exact) > 3u)) continue;
+
+        const uint8_t remaining = sids & ~exact;
+
+        if (remaining) {
+            filters_plan_groups(remaining, &candidate);
+        } else {
+            candidate.coverage   = 0u;
+            candidate.group_mask = 0u;
+            candidate.groups[0u] = 0u;
+            candidate.groups[1u] = 0u;
+        }
+        candidate.exact = exact;
+
+        const uint8_t extra = __builtin_popcount(candidate.coverage & ~sids);
+        if (extra < best_extra) {
+            best_extra = extra;
+            *plan      = candidate;
+            if (extra == 0u) break;
+        }
+    }
+}
+
+static unsigned long filter_for_sid(uint8_t sid)
+{
+    return caniot_device_get_filter(CANIOT_DID(__DEVICE_CLS__, sid));
+}
+
+static void can_filters_apply(void)
+{
+#if CONFIG_DEVICE_SINGLE_INSTANCE
+    const uint8_t sids = BIT(__DEVICE_SID__);
+#else
+    const uint8_t sids = ((1u << CONFIG_DEVICE_INSTANCES_COUNT) - 1u)
+                         << CONFIG_DEVICE_MULTI_FIRST_SID;
+#endif
+
+    const unsigned long filter_broadcast = caniot_device_get_filter_broadcast();
+    const unsigned long mask_exact       = caniot_device_get_mask();
+    const unsigned long mask_cls         = caniot_device_get_mask_by_cls();
+    const unsigned long sid_bits         = mask_exact ^ mask_cls;
+
+    struct filters_plan plan;
+    unsigned long exact_filters[3u];
+    uint8_t n = 0u;
+
+    filters_plan_build(sids, &plan);
+
+    for (uint8_t sid = 0u; sid < SID_COUNT; sid++) {
+        if (plan.exact & BIT(sid)) exact_filters[n++] = filter_for_sid(sid);
+    }
+    for (uint8_t i = n; i < ARRAY_SIZE(exact_filters); i++) {
+        exact_filters[i] = n ? exact_filters[0u] : filter_broadcast;
+    }
+
+    LOG_DBG("CAN filters: exact %02x group mask %x [%u %u] coverage %02x",
+            plan.exact,
+            plan.group_mask,
+            plan.groups[0u],
+            plan.groups[1u],
+            plan.coverage);
+
+    if (plan.coverage) {
+        const unsigned long mask = mask_cls | (filter_for_sid(plan.group_mask) & sid_bits);
+
+        mcp2515_set_mask(&mcp, 0u, CAN_STD_ID, mask);
+        mcp2515_set_filter(&mcp, 0u, CAN_STD_ID, filter_for_sid(plan.groups[0u]));
+        mcp2515_set_filter(&mcp, 1u, CAN_STD_ID, filter_for_sid(plan.groups[1u]));
+    } else {
+        mcp2515_set_mask(&mcp, 0u, CAN_STD_ID, mask_exact);
+        mcp2515_set_filter(&mcp, 0u, CAN_STD_ID, exact_filters[0u]);
+        mcp2515_set_filter(&mcp, 1u, CAN_STD_ID, exact_filters[0u]);
+    }
+
+    mcp2515_set_mask(&mcp, 1u, CAN_STD_ID, mask_exact);
+    mcp2515_set_filter(&mcp, 2u, CAN_STD_ID, filter_broadcast);
+    mcp2515_set_filter(&mcp, 3u, CAN_STD_ID, exact_filters[0u]);
+    mcp2515_set_filter(&mcp, 4u, CAN_STD_ID, exact_filters[1u]);
+    mcp2515_set_filter(&mcp, 5u, CAN_STD_ID, exact_filters[2u]);
+}
+
+#endif /* CONFIG_CAN_SOFT_FILTERING == 0 */
+
 void can_init(void)
 {
     __ASSERT_INTERRUPT();
@@ -73,30 +255,11 @@ void can_init(void)
     }
 
 #if CONFIG_CAN_SOFT_FILTERING == 0
-    const unsigned long filter_broadcast = caniot_device_get_filter_broadcast();
-#if CONFIG_DEVICE_SINGLE_INSTANCE
-    const unsigned long mask        = caniot_device_get_mask();
-    const unsigned long filter_self = caniot_device_get_filter(DEVICE_DID);
+    can_filters_apply();
 #else
-    const unsigned long mask        = caniot_device_get_mask_by_cls();
-    const unsigned long filter_self = caniot_device_get_filter_by_cls(__DEVICE_CLS__);
-#endif
-
-    mcp2515_set_mask(&mcp, 0u, CAN_STD_ID, mask);
-	mcp2515_set_filter(&mcp, 0u, CAN_STD_ID, filter_self);
-	mcp2515_set_filter(&mcp, 1u, CAN_STD_ID, filter_self);
-
-	mcp2515_set_mask(&mcp, 1u, CAN_STD_ID, mask);
-	mcp2515_set_filter(&mcp, 2u, CAN_STD_ID, filter_broadcast);
-	mcp2515_set_filter(&mcp, 3u, CAN_STD_ID, filter_broadcast);
-	mcp2515_set_filter(&mcp, 4u, CAN_STD_ID, filter_broadcast);
-	mcp2515_set_filter(&mcp, 5u, CAN_STD_ID, filter_broadcast);
-#elif CONFIG_DEVICE_SINGLE_INSTANCE
     // TODO understand by the sample crash if no mask is set with DevBoardTinyB
     mcp2515_set_mask(&mcp, 0u, CAN_EXT_ID, 0x0ul);
 	mcp2515_set_mask(&mcp, 1u, CAN_EXT_ID, 0x0ul);
-#else
-#error "CONFIG_CAN_SOFT_FILTERING not supported for multi instance devices"
 #endif
 }
 
@@ -106,39 +269,74 @@ ISR(BSP_CAN_INT_vect)
     serial_transmit('%');
 #endif
 
+    latency_rx_mark();
+    metrics_inc(METRICS_IRQ_CAN);
+
     int8_t ret = dev_trigger_process();
 
     /* Immediately yield to schedule main thread */
     if (ret > 0) k_yield_from_isr();
 }
 
-int can_recv(struct can_frame *msg)
+/* Move all frames pending in the MCP2515 receive buffers to the RX ring,
+ * so that the controller buffers are freed as soon as possible and a burst
+ * of frames doesn't overrun them while the previous ones are processed.
+ */
+static int8_t can_rx_drain(void)
 {
-    __ASSERT_NOTNULL(msg);
+    int8_t rc = 0;
 
-    int8_t rc;
+    while (rx_count < CONFIG_CAN_RX_RING_SIZE) {
+        struct can_frame *const slot = &rx_ring[(rx_head + rx_count) & RX_RING_MASK];
+
+        rc = mcp2515_recv(&mcp, slot);
+        if (rc != 0) {
+            break;
+        }
+
+        LOG_DBG_RAW("CAN RX ext: %u rtr: %u id: %04x%04x: ",
+                    slot->is_ext,
+                    slot->rtr,
+                    (uint16_t)(slot->id >> 16u),
+                    (uint16_t)(slot->id & 0xFFFFu));
+        LOG_HEXDUMP_DBG(slot->data, slot->len);
+
+        metrics_inc(METRICS_CAN_RX);
+        rx_count++;
+    }
 
-    rc = mcp2515_recv(&mcp, msg);
     if (rc == -ENOMSG) {
-        rc = -EAGAIN;
-        goto exit;
+        rc = 0;
     } else if (rc != 0) {
         LOG_ERR("mcp2515_recv failed err: %d", rc);
-        rc = -EIO;
-        goto exit;
     }
 
-    LOG_DBG_RAW("CAN RX ext: %u rtr: %u id: %04x%04x: ",
-                msg->is_ext,
-                msg->rtr,
-                (uint16_t)(msg->id >> 16u),
-                (uint16_t)(msg->id & 0xFFFFu));
-    LOG_HEXDUMP_DBG(msg->data, msg->len);
-
-exit:
     return rc;
 }
 
+int can_recv_peek(const struct can_frame **msg)
+{
+    __ASSERT_NOTNULL(msg);
+
+    int8_t rc = can_rx_drain();
+
+    if (rx_count == 0u) {
+        return (rc == 0) ? -EAGAIN : -EIO;
+    }
+
+    *msg = &rx_ring[rx_head];
+
+    return 0;
+}
+
+void can_recv_release(void)
+{
+    if (rx_count) {
+        rx_head = (rx_head + 1u) & RX_RING_MASK;
+        rx_count--;
+    }
+}
+
 #if CONFIG_CAN_WTD_MAX_ERROR_COUNT != -1
 static void can_watchdog(bool ok)
 {
@@ -162,9 +360,14 @@ static uint8_t can_send(const struct can_frame *msg)
 
     // can_print_msg(&msg);
 
+    latency_tx_mark();
+
     int8_t rc = mcp2515_send(&mcp, msg);
     if (rc != 0) {
+        metrics_inc(METRICS_CAN_TX_ERROR);
         LOG_ERR("mcp2515_send failed err: %d", rc);
+    } else {
+        metrics_inc(METRICS_CAN_TX);
     }
 
     return rc;
@@ -182,49 +385,127 @@ void can_print_msg(const struct can_frame *msg)
     LOG_HEXDUMP_DBG(msg->data, MIN(msg->len, 8U));
 }
 
-int can_txq_message(const struct can_frame *msg)
+struct can_frame *can_txq_alloc(void)
 {
-    int ret = k_msgq_put(&txq, msg, K_NO_WAIT);
+    struct can_frame *msg = NULL;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (tx_count < CONFIG_CAN_TX_MSGQ_SIZE) {
+            msg     = &tx_ring[tx_head];
+            tx_head = TX_RING_NEXT(tx_head);
+            tx_count++;
+        } else {
+            metrics_inc(METRICS_CAN_TXQ_FULL);
+        }
+    }
 
-    if (ret == 0) {
-#if CONFIG_CAN_WORKQ_OFFLOADED
-        k_system_workqueue_submit(&can_tx_work);
-#endif
-    } else if (ret == -ENOMEM) {
+    if (!msg) {
         LOG_ERR("can txq full");
     }
 
-    return ret;
+    return msg;
 }
 
+void can_txq_commit(struct can_frame *msg)
+{
+    const uint8_t slot = msg - tx_ring;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        tx_committed |= BIT(slot);
+    }
+
 #if CONFIG_CAN_WORKQ_OFFLOADED
-static void can_tx_wq_cb(struct k_work *work)
+    k_system_workqueue_submit(&can_tx_work);
+#else
+    k_sem_give(&tx_sem);
+#endif
+}
+
+int can_txq_message(const struct can_frame *msg)
 {
-    struct can_frame msg;
-    while (k_msgq_get(&txq, &msg, K_NO_WAIT) == 0) {
-        uint8_t rc = can_send(&msg);
+    struct can_frame *const slot = can_txq_alloc();
+
+    if (!slot) {
+        return -ENOMEM;
+    }
+
+    memcpy(slot, msg, sizeof(*slot));
+    can_txq_commit(slot);
+
+    return 0;
+}
+
+/* Send the oldest frame if committed and release its slot.
+ *
+ * The frame is kept in the ring if the controller refused it, so that the
+ * caller can retry once a transmit buffer is available. A frame is dropped
+ * after CONFIG_CAN_TX_RETRY_COUNT retries.
+ *
+ * Return 0 if the slot was released, -EAGAIN if the frame must be retried,
+ * -ENOENT if the oldest frame is not committed yet (or the ring is empty).
+ */
+static int8_t can_tx_process(void)
+{
+    if (!(tx_committed & BIT(tx_tail))) {
+        return -ENOENT;
+    }
+
+    uint8_t rc = can_send(&tx_ring[tx_tail]);
+
+    if ((rc != 0) && (tx_retries < CONFIG_CAN_TX_RETRY_COUNT)) {
+        tx_retries++;
+        return -EAGAIN;
+    }
+
+    tx_retries = 0u;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        tx_committed &= ~BIT(tx_tail);
+        tx_tail = TX_RING_NEXT(tx_tail);
+        tx_count--;
+    }
 
 #if CONFIG_CAN_WTD_MAX_ERROR_COUNT != -1
-        can_watchdog(rc == CAN_OK);
-#else
-        (void)rc;
+    can_watchdog(rc == CAN_OK);
 #endif
+
+    return 0;
+}
+
+#if CONFIG_CAN_WORKQ_OFFLOADED
+static void can_tx_wq_cb(struct k_work *work)
+{
+    int8_t rc;
+
+    /* Send all committed frames back-to-back */
+    while ((rc = can_tx_process()) == 0) {
+    }
+
+    /* Let the controller transmit the pending frames, rather than spinning
+     * the system workqueue.
+     */
+    if (rc == -EAGAIN) {
+        (void)k_system_work_delayable_schedule(&can_tx_retry_work,
+                                               K_MSEC(CONFIG_CAN_TX_RETRY_DELAY_MS));
     }
 }
 #else
 static void can_tx_entry(void *arg)
 {
-    struct can_frame msg;
-    while (1) {
-        if (k_msgq_get(&txq, &msg, K_FOREVER) == 0) {
-            uint8_t rc = can_send(&msg);
+    int8_t rc;
 
-#if CONFIG_CAN_WTD_MAX_ERROR_COUNT != -1
-            can_watchdog(rc == CAN_OK);
-#else
-            (void)rc;
-#endif
+    while (1) {
+        if (k_sem_take(&tx_sem, K_FOREVER) == 0) {
+            while ((rc = can_tx_process()) != -ENOENT) {
+                if (rc == -EAGAIN) {
+                    /* Let the controller transmit the pending frames */
+                    k_sleep(K_MSEC(CONFIG_CAN_TX_RETRY_DELAY_MS));
+                }
+            }
         }
     }
 }
-#endif
\ No newline at end of file
+#endif
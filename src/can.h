@@ -23,16 +23,51 @@ extern "C" {
 void can_init(void);
 
 /**
- * @brief Receive a CAN message
+ * @brief Get a reference to the oldest received CAN message, without copying it
  *
- * @param msg Buffer to store the message
+ * The message stays valid until can_recv_release() is called.
+ *
+ * @param msg Pointer set to the message in the RX buffer
  * @return int
- *  * 0 if no message is available
+ *  * 0 if a message is available
  *  * -EAGAIN if no message is available
  *  * -EIO if device error occured
  */
-int can_recv(struct can_frame *msg);
+int can_recv_peek(const struct can_frame **msg);
+
+/**
+ * @brief Release the message returned by can_recv_peek()
+ */
+void can_recv_release(void);
+
+/**
+ * @brief Allocate a message in the TX queue, to be built in place
+ *
+ * The message is sent once queued with can_txq_commit(), which must be called
+ * before yielding.
+ *
+ * Note: The TX queue API is not ISR-safe, it must be called from a thread
+ * (e.g. defer to a work item from an event handler).
+ *
+ * @return struct can_frame* NULL if the queue is full
+ */
+struct can_frame *can_txq_alloc(void);
+
+/**
+ * @brief Queue a message allocated with can_txq_alloc() for transmission
+ *
+ * @param msg Message returned by can_txq_alloc()
+ */
+void can_txq_commit(struct can_frame *msg);
 
+/**
+ * @brief Copy a message to the TX queue
+ *
+ * Note: Not ISR-safe, see can_txq_alloc()
+ *
+ * @param msg
+ * @return int 0 on success, -ENOMEM if the queue is full
+ */
 int can_txq_message(const struct can_frame *msg);
 
 void can_print_msg(const struct can_frame *msg);
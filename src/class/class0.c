@@ -41,14 +41,19 @@ int class0_blc_telemetry_handler(struct caniot_device *dev,
 {
     struct caniot_blc0_telemetry data = {0};
 
-    data.dio |= bsp_descr_gpio_input_read(BSP_OC1) << OC1_IDX;
-    data.dio |= bsp_descr_gpio_input_read(BSP_OC2) << OC2_IDX;
-    data.dio |= bsp_descr_gpio_input_read(BSP_RL1) << RL1_IDX;
-    data.dio |= bsp_descr_gpio_input_read(BSP_RL2) << RL2_IDX;
-    data.dio |= bsp_descr_gpio_input_read(BSP_IN1) << IN1_IDX;
-    data.dio |= bsp_descr_gpio_input_read(BSP_IN2) << IN2_IDX;
-    data.dio |= bsp_descr_gpio_input_read(BSP_IN3) << IN3_IDX;
-    data.dio |= bsp_descr_gpio_input_read(BSP_IN4) << IN4_IDX;
+    /* Read each port only once */
+    const uint8_t pinc = bsp_descr_gpio_port_read(BSP_OC1);
+    const uint8_t pinb = bsp_descr_gpio_port_read(BSP_IN1);
+    const uint8_t pind = bsp_descr_gpio_port_read(BSP_IN2);
+
+    data.dio |= BSP_DESCR_PORT_PIN_STATE(pinc, BSP_OC1) << OC1_IDX;
+    data.dio |= BSP_DESCR_PORT_PIN_STATE(pinc, BSP_OC2) << OC2_IDX;
+    data.dio |= BSP_DESCR_PORT_PIN_STATE(pinc, BSP_RL1) << RL1_IDX;
+    data.dio |= BSP_DESCR_PORT_PIN_STATE(pinc, BSP_RL2) << RL2_IDX;
+    data.dio |= BSP_DESCR_PORT_PIN_STATE(pinb, BSP_IN1) << IN1_IDX;
+    data.dio |= BSP_DESCR_PORT_PIN_STATE(pind, BSP_IN2) << IN2_IDX;
+    data.dio |= BSP_DESCR_PORT_PIN_STATE(pind, BSP_IN3) << IN3_IDX;
+    data.dio |= BSP_DESCR_PORT_PIN_STATE(pind, BSP_IN4) << IN4_IDX;
 
 #if CONFIG_GPIO_PULSE_SUPPORT
     data.pdio |= pulse_is_active(xps_ctx[OC1_IDX].pev) ? (1 << OC1_IDX) : 0;
@@ -62,30 +62,37 @@ int class1_blc_telemetry_handler(struct caniot_device *dev,
 {
     struct caniot_blc1_telemetry data = {0};
 
-    data.pcpd |= bsp_descr_gpio_input_read(BSP_PC0) << PC0_IDX;
-    data.pcpd |= bsp_descr_gpio_input_read(BSP_PC1) << PC1_IDX;
-    data.pcpd |= bsp_descr_gpio_input_read(BSP_PC2) << PC2_IDX;
-    data.pcpd |= bsp_descr_gpio_input_read(BSP_PC3) << PC3_IDX;
-    data.pcpd |= bsp_descr_gpio_input_read(BSP_PD4) << PD4_IDX;
-    data.pcpd |= bsp_descr_gpio_input_read(BSP_PD5) << PD5_IDX;
-    data.pcpd |= bsp_descr_gpio_input_read(BSP_PD6) << PD6_IDX;
-    data.pcpd |= bsp_descr_gpio_input_read(BSP_PD7) << PD7_IDX;
-
-    /* TODO: Optimize this to read only a single time PCF state */
-    data.eio |= bsp_descr_gpio_input_read(BSP_EIO0) << (EIO0_IDX & 0x7u);
-    data.eio |= bsp_descr_gpio_input_read(BSP_EIO1) << (EIO1_IDX & 0x7u);
-    data.eio |= bsp_descr_gpio_input_read(BSP_EIO2) << (EIO2_IDX & 0x7u);
-    data.eio |= bsp_descr_gpio_input_read(BSP_EIO3) << (EIO3_IDX & 0x7u);
-    data.eio |= bsp_descr_gpio_input_read(BSP_EIO4) << (EIO4_IDX & 0x7u);
-    data.eio |= bsp_descr_gpio_input_read(BSP_EIO5) << (EIO5_IDX & 0x7u);
-    data.eio |= bsp_descr_gpio_input_read(BSP_EIO6) << (EIO6_IDX & 0x7u);
-    data.eio |= bsp_descr_gpio_input_read(BSP_EIO7) << (EIO7_IDX & 0x7u);
-
-    data.pb0 = bsp_descr_gpio_input_read(BSP_PB0);
+    /* Read each port only once, a single I2C transaction for the PCF8574 */
+    const uint8_t pinc = bsp_descr_gpio_port_read(BSP_PC0);
+    const uint8_t pind = bsp_descr_gpio_port_read(BSP_PD4);
+    const uint8_t eio  = bsp_descr_gpio_port_read(BSP_EIO0);
+    const uint8_t pinb = bsp_descr_gpio_port_read(BSP_PB0);
+
+    data.pcpd |= BSP_DESCR_PORT_PIN_STATE(pinc, BSP_PC0) << PC0_IDX;
+    data.pcpd |= BSP_DESCR_PORT_PIN_STATE(pinc, BSP_PC1) << PC1_IDX;
+    data.pcpd |= BSP_DESCR_PORT_PIN_STATE(pinc, BSP_PC2) << PC2_IDX;
+    data.pcpd |= BSP_DESCR_PORT_PIN_STATE(pinc, BSP_PC3) << PC3_IDX;
+    data.pcpd |= BSP_DESCR_PORT_PIN_STATE(pind, BSP_PD4) << PD4_IDX;
+    data.pcpd |= BSP_DESCR_PORT_PIN_STATE(pind, BSP_PD5) << PD5_IDX;
+    data.pcpd |= BSP_DESCR_PORT_PIN_STATE(pind, BSP_PD6) << PD6_IDX;
+    data.pcpd |= BSP_DESCR_PORT_PIN_STATE(pind, BSP_PD7) << PD7_IDX;
+
+    data.eio |= BSP_DESCR_PORT_PIN_STATE(eio, BSP_EIO0) << (EIO0_IDX & 0x7u);
+    data.eio |= BSP_DESCR_PORT_PIN_STATE(eio, BSP_EIO1) << (EIO1_IDX & 0x7u);
+    data.eio |= BSP_DESCR_PORT_PIN_STATE(eio, BSP_EIO2) << (EIO2_IDX & 0x7u);
+    data.eio |= BSP_DESCR_PORT_PIN_STATE(eio, BSP_EIO3) << (EIO3_IDX & 0x7u);
+    data.eio |= BSP_DESCR_PORT_PIN_STATE(eio, BSP_EIO4) << (EIO4_IDX & 0x7u);
+    data.eio |= BSP_DESCR_PORT_PIN_STATE(eio, BSP_EIO5) << (EIO5_IDX & 0x7u);
+    data.eio |= BSP_DESCR_PORT_PIN_STATE(eio, BSP_EIO6) << (EIO6_IDX & 0x7u);
+    data.eio |= BSP_DESCR_PORT_PIN_STATE(eio, BSP_EIO7) << (EIO7_IDX & 0x7u);
+
+    data.pb0 = BSP_DESCR_PORT_PIN_STATE(pinb, BSP_PB0);
 
 #if BSP_PORTE_SUPPORT
-    data.pe0 = bsp_descr_gpio_input_read(BSP_PE0);
-    data.pe1 = bsp_descr_gpio_input_read(BSP_PE1);
+    const uint8_t pine = bsp_descr_gpio_port_read(BSP_PE0);
+
+    data.pe0 = BSP_DESCR_PORT_PIN_STATE(pine, BSP_PE0);
+    data.pe1 = BSP_DESCR_PORT_PIN_STATE(pine, BSP_PE1);
 #endif
 
 #if CONFIG_CANIOT_FAKE_TEMPERATURE
@@ -122,6 +129,9 @@ int class1_blc_command_handler(struct caniot_device *dev,
         directions >>= 1u;
     }
 
+    /* Apply all commanded outputs at once */
+    bsp_gpio_commit();
+
     if (len == 8u) caniot_blc_sys_command_from_byte(&sys_cmd, buf[7u]);
 
     return dev_apply_blc_sys_command(dev, &sys_cmd);
@@ -146,6 +156,11 @@ int class1_config_apply(struct caniot_device *dev, bool init)
         xps_ctx[i].reset_state = output_default;
     }
 
+#if CONFIG_EXTIO_INPUT_CACHE
+    bsp_extio_set_notify_mask(
+        EXTIO_DEVICE(0u), (uint8_t)(config->cls1_gpio.telemetry_on_change >> EIO0_IDX));
+#endif
+
     return 0;
 }
 
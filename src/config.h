@@ -18,11 +18,18 @@
 #define __MULTI_INSTANCES_COUNT__ 0u
 #endif
 
+/* Sub-identifier of the first instance, instances use consecutive SIDs */
+#if !defined(__MULTI_FIRST_SID__)
+#define __MULTI_FIRST_SID__ 0u
+#endif
+
 #if !__MULTI_INSTANCES__
 #elif __MULTI_INSTANCES_COUNT__ > 8
 #error "With __MULTI_INSTANCES__ enabled, maximum number of instances is 8"
 #elif __MULTI_INSTANCES_COUNT__ <= 1
 #error "With __MULTI_INSTANCES__ enabled, minimum number of instances is 2"
+#elif (__MULTI_FIRST_SID__ + __MULTI_INSTANCES_COUNT__) > 8
+#error "With __MULTI_INSTANCES__ enabled, the last instance SID must be <= 7"
 #endif
 
 #if !defined(CONFIG_GPIO_PULSE_SUPPORT)
@@ -77,10 +84,58 @@
 #define CONFIG_FORCE_RESTORE_DEFAULT_CONFIG 0U
 #endif
 
+/* CRC-8 implementation: bitwise (no table), nibble (16 bytes table) or table
+ * (256 bytes table), tables are stored in flash.
+ */
+#define CRC8_IMPL_BITWISE 0u
+#define CRC8_IMPL_NIBBLE  1u
+#define CRC8_IMPL_TABLE   2u
+
+#if !defined(CONFIG_CRC8_IMPL)
+#define CONFIG_CRC8_IMPL CRC8_IMPL_NIBBLE
+#endif
+
+/* Program the EEPROM from the EE_READY interrupt, writers only queue the bytes */
+#if !defined(CONFIG_EEPROM_WRITE_BEHIND)
+#define CONFIG_EEPROM_WRITE_BEHIND 1U
+#endif
+
+/* Number of bytes waiting to be programmed (power of 2) */
+#if !defined(CONFIG_EEPROM_WRITE_BEHIND_QUEUE_SIZE)
+#define CONFIG_EEPROM_WRITE_BEHIND_QUEUE_SIZE 16U
+#endif
+
+/* Append the changed configuration bytes to a journal in EEPROM instead of
+ * rewriting the whole configuration block, the journal is folded back into
+ * the block when full. The journal uses the EEPROM left after the other
+ * regions (see the EEPROM layout in ee.h), which is too small to be shared
+ * between the instances of multi-instance devices.
+ */
+#if !defined(CONFIG_SETTINGS_JOURNAL)
+#if __MULTI_INSTANCES__
+#define CONFIG_SETTINGS_JOURNAL 0U
+#else
+#define CONFIG_SETTINGS_JOURNAL 1U
+#endif
+#endif
+
+/* Max number of configuration bytes per journal record */
+#if !defined(CONFIG_SETTINGS_JOURNAL_CHUNK)
+#define CONFIG_SETTINGS_JOURNAL_CHUNK 16U
+#endif
+
 #if !defined(CONFIG_APP_MAX_PROCESS_INTERVAL_MS)
 #define CONFIG_APP_MAX_PROCESS_INTERVAL_MS 1000U
 #endif
 
+/* By default app_process() is called on every wake up of the main thread.
+ * Applications which don't poll can opt in to be called only on
+ * DEV_EVENT_APP or every CONFIG_APP_MAX_PROCESS_INTERVAL_MS.
+ */
+#if !defined(CONFIG_APP_PROCESS_ON_DEADLINE)
+#define CONFIG_APP_PROCESS_ON_DEADLINE 0U
+#endif
+
 #if !defined(CONFIG_OW_DS_COUNT)
 #define CONFIG_OW_DS_COUNT 0U
 #endif
@@ -105,6 +160,66 @@
 #define CONFIG_OW_DS_PROCESS_PERIOD_MS 10000U
 #endif
 
+/* Convert all OW sensors at once (SKIP ROM + CONVERT T) then read them
+ * sequentially, instead of measuring one sensor per period.
+ * CONFIG_OW_DS_PROCESS_PERIOD_MS is then the period between two full refreshes.
+ */
+#if !defined(CONFIG_OW_DS_BROADCAST_CONVERSION)
+#define CONFIG_OW_DS_BROADCAST_CONVERSION 1U
+#endif
+
+/* DS18B20 conversion resolution in bits (9 to 12), can be set per sensor
+ * with CONFIG_OW_DS_RESOLUTION_<n>. Conversion takes 94, 188, 375 or 750 ms.
+ */
+#if !defined(CONFIG_OW_DS_RESOLUTION)
+#define CONFIG_OW_DS_RESOLUTION 12U
+#endif
+
+#if !defined(CONFIG_OW_DS_RESOLUTION_1)
+#define CONFIG_OW_DS_RESOLUTION_1 CONFIG_OW_DS_RESOLUTION
+#endif
+
+#if !defined(CONFIG_OW_DS_RESOLUTION_2)
+#define CONFIG_OW_DS_RESOLUTION_2 CONFIG_OW_DS_RESOLUTION
+#endif
+
+#if !defined(CONFIG_OW_DS_RESOLUTION_3)
+#define CONFIG_OW_DS_RESOLUTION_3 CONFIG_OW_DS_RESOLUTION
+#endif
+
+/* End the conversion wait as soon as the sensors report completion on the bus.
+ * Only for externally powered sensors: parasite powered sensors need the bus
+ * to be held high during the whole conversion.
+ */
+#if !defined(CONFIG_OW_DS_CONVERSION_POLLING)
+#define CONFIG_OW_DS_CONVERSION_POLLING 0U
+#endif
+
+#if !defined(CONFIG_OW_DS_POLL_INTERVAL_MS)
+#define CONFIG_OW_DS_POLL_INTERVAL_MS 20U
+#endif
+
+/* Drive the periodic OneWire conversions and scratchpad reads from the
+ * timer 0 compare B interrupt instead of bit-banging them in the system
+ * workqueue. Discovery and resolution setup remain blocking.
+ * Timer 0 is switched to normal mode: its PWM outputs (D5/D6) are lost.
+ */
+#if !defined(CONFIG_OW_ASYNC)
+#define CONFIG_OW_ASYNC 0U
+#endif
+
+#if CONFIG_OW_ASYNC && !CONFIG_OW_DS_BROADCAST_CONVERSION
+#error "CONFIG_OW_ASYNC requires CONFIG_OW_DS_BROADCAST_CONVERSION"
+#endif
+
+/* Keep the ROMs of the discovered OW sensors in EEPROM, known sensors are then
+ * only verified (MATCH ROM) at boot and on rediscovery, the full ROM search is
+ * limited to the case where sensor slots are still free.
+ */
+#if !defined(CONFIG_OW_DS_ROM_CACHE)
+#define CONFIG_OW_DS_ROM_CACHE 1U
+#endif
+
 #if !defined(CONFIG_SHELL)
 #define CONFIG_SHELL 0u
 #endif
@@ -153,10 +268,52 @@
 #define CONFIG_EXTIO_ENABLED 0u
 #endif
 
+/* Stage extended IO writes and flush them in a single transaction, either on
+ * bsp_gpio_commit() or from the system workqueue.
+ */
+#if !defined(CONFIG_EXTIO_WRITE_COMBINING)
+#define CONFIG_EXTIO_WRITE_COMBINING 1u
+#endif
+
+/* Read the extended IOs from the system workqueue on PCF8574 interrupt and
+ * serve readers from the cached state, input changes trigger the board
+ * control telemetry according to the class 1 telemetry_on_change mask.
+ */
+#if !defined(CONFIG_EXTIO_INPUT_CACHE)
+#define CONFIG_EXTIO_INPUT_CACHE 0u
+#endif
+
+#if CONFIG_EXTIO_INPUT_CACHE && !CONFIG_PCF8574_INT_ENABLED
+#error "CONFIG_EXTIO_INPUT_CACHE requires CONFIG_PCF8574_INT_ENABLED"
+#endif
+
+/* Input changes (PCINT, extended IO) are coalesced into a single board
+ * control telemetry sent CONFIG_TELEMETRY_ON_CHANGE_HOLDOFF_MS after the
+ * first edge, two such telemetries are at least
+ * CONFIG_TELEMETRY_ON_CHANGE_MIN_GAP_MS apart.
+ */
+#if !defined(CONFIG_TELEMETRY_ON_CHANGE_HOLDOFF_MS)
+#define CONFIG_TELEMETRY_ON_CHANGE_HOLDOFF_MS 50u
+#endif
+
+#if !defined(CONFIG_TELEMETRY_ON_CHANGE_MIN_GAP_MS)
+#define CONFIG_TELEMETRY_ON_CHANGE_MIN_GAP_MS 250u
+#endif
+
 #if !defined(CONFIG_TCN75)
 #define CONFIG_TCN75 0u
 #endif
 
+/* Period at which the TCN75 is sampled in the background (ms) */
+#if !defined(CONFIG_TCN75_SAMPLE_PERIOD_MS)
+#define CONFIG_TCN75_SAMPLE_PERIOD_MS 2000u
+#endif
+
+/* Cached TCN75 reading is reported invalid once older than this (ms) */
+#if !defined(CONFIG_TCN75_MAX_AGE_MS)
+#define CONFIG_TCN75_MAX_AGE_MS (3u * CONFIG_TCN75_SAMPLE_PERIOD_MS)
+#endif
+
 #if !defined(CONFIG_CAN_CONTEXT_LOCK)
 #define CONFIG_CAN_CONTEXT_LOCK 0u
 #endif
@@ -173,8 +330,26 @@
 #define CONFIG_CAN_WORKQ_OFFLOADED 0u
 #endif
 
+/* Depth of the CAN TX queue, default allows a telemetry burst on all 4 endpoints */
 #if !defined(CONFIG_CAN_TX_MSGQ_SIZE)
-#define CONFIG_CAN_TX_MSGQ_SIZE 1u
+#define CONFIG_CAN_TX_MSGQ_SIZE 4u
+#endif
+
+/* Number of times a frame is retried when the MCP2515 refuses it (e.g. all
+ * transmit buffers busy) before being dropped.
+ */
+#if !defined(CONFIG_CAN_TX_RETRY_COUNT)
+#define CONFIG_CAN_TX_RETRY_COUNT 3u
+#endif
+
+/* Delay before retrying a frame refused by the MCP2515 (ms) */
+#if !defined(CONFIG_CAN_TX_RETRY_DELAY_MS)
+#define CONFIG_CAN_TX_RETRY_DELAY_MS 1u
+#endif
+
+/* Number of received frames buffered in RAM (power of 2) */
+#if !defined(CONFIG_CAN_RX_RING_SIZE)
+#define CONFIG_CAN_RX_RING_SIZE 4u
 #endif
 
 // Enabled if value is different from -1
@@ -185,6 +360,46 @@
 #error "CONFIG_CAN_WTD_MAX_ERROR_COUNT must be different from 0"
 #endif
 
+/* Measure the CAN request -> response latency (see latency.c) */
+#if !defined(CONFIG_CAN_LATENCY_TRACE)
+#define CONFIG_CAN_LATENCY_TRACE 0u
+#endif
+
+#if !defined(CONFIG_CAN_LATENCY_BUCKET_CYCLES)
+#define CONFIG_CAN_LATENCY_BUCKET_CYCLES 4096lu
+#endif
+
+#if !defined(CONFIG_CAN_LATENCY_BUCKETS_COUNT)
+#define CONFIG_CAN_LATENCY_BUCKETS_COUNT 32u
+#endif
+
+/* Turn off the ADC and the analog comparator, only for boards and
+ * applications which don't use them (see power.c)
+ */
+#if !defined(CONFIG_POWER_ADC_UNUSED)
+#define CONFIG_POWER_ADC_UNUSED 0u
+#endif
+
+/* Put the CPU in idle sleep when no thread is ready (see power.c) */
+#if !defined(CONFIG_POWER_IDLE_SLEEP)
+#define CONFIG_POWER_IDLE_SLEEP 0u
+#endif
+
+/* Stack of the sleep thread, which holds the frame of any interrupt taken
+ * while idle, including a full context save when the sysclock preempts it.
+ * Check the usage with the shell canaries dump ('c').
+ */
+#if !defined(CONFIG_POWER_SLEEP_THREAD_STACK_SIZE)
+#define CONFIG_POWER_SLEEP_THREAD_STACK_SIZE 96u
+#endif
+
+/* Count interrupts, CAN frames and EEPROM writes, exposed through the
+ * DEV_ATTR_KEY_METRICS attribute (see metrics.h)
+ */
+#if !defined(CONFIG_METRICS)
+#define CONFIG_METRICS 0u
+#endif
+
 #if !defined(CONFIG_CHECKS)
 #define CONFIG_CHECKS 1u
 #endif
@@ -227,12 +442,17 @@
 #define CONFIG_DEVICE_INSTANCES_COUNT __MULTI_INSTANCES_COUNT__
 #define CONFIG_DEVICE_SINGLE_INSTANCE 0
 
-#define CONFIG_DEVICE_MULTI_FIRST_SID 0u
-#define CONFIG_DEVICE_MULTI_LAST_SID  (__MULTI_INSTANCES_COUNT__ - 1u)
+#define CONFIG_DEVICE_MULTI_FIRST_SID __MULTI_FIRST_SID__
+#define CONFIG_DEVICE_MULTI_LAST_SID  (__MULTI_FIRST_SID__ + __MULTI_INSTANCES_COUNT__ - 1u)
 #define CONFIG_DEVICE_MULTI_SID(_n)   (CONFIG_DEVICE_MULTI_FIRST_SID + (_n))
 #if defined(__DEVICE_SID__)
 #error "__DEVICE_SID__ must not be defined when __MULTI_INSTANCES__ is enabled"
 #endif
+
+/* Number of received frames which can be queued for all instances */
+#if !defined(CONFIG_DEVICE_MULTI_RX_POOL_SIZE)
+#define CONFIG_DEVICE_MULTI_RX_POOL_SIZE 8u
+#endif
 #else
 #define CONFIG_DEVICE_INSTANCES_COUNT 1
 #define CONFIG_DEVICE_SINGLE_INSTANCE 1
@@ -262,8 +482,4 @@
 #define CONFIG_DIAG_RESET_CONTEXT_HISTORY 1u
 #endif
 
-#ifndef CONFIG_DIAG_RESET_CONTEXT_STATIC_RAMBUFFER
-#define CONFIG_DIAG_RESET_CONTEXT_STATIC_RAMBUFFER 0u
-#endif
-
 #endif /* _APP_CONFIG_H_ */
\ No newline at end of file
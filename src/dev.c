@@ -9,6 +9,7 @@
 #include "config.h"
 #include "dev.h"
 #include "diag.h"
+#include "metrics.h"
 #include "platform.h"
 #include "settings.h"
 #include "watchdog.h"
@@ -28,6 +29,21 @@
 
 K_SIGNAL_DEFINE(dev_process_sig);
 
+volatile uint8_t dev_events = 0u;
+
+uint8_t dev_events_take(void)
+{
+    uint8_t events;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        events     = dev_events;
+        dev_events = 0u;
+    }
+
+    return events;
+}
+
 extern const caniot_telemetry_handler_t app_telemetry_handler;
 extern const caniot_command_handler_t app_command_handler;
 
@@ -127,9 +143,10 @@ static int attr_read(struct caniot_device *dev, uint16_t key, uint32_t *val)
 {
     int ret = 0;
 
-#if CONFIG_DIAG && (CONFIG_DIAG_RESET_REASON || CONFIG_DIAG_RESET_CONTEXT_RUNTIME)
+#if (CONFIG_DIAG && (CONFIG_DIAG_RESET_REASON || CONFIG_DIAG_RESET_CONTEXT_RUNTIME)) ||     \
+    CONFIG_METRICS
     uint8_t key_part = caniot_attr_key_get_part(key);
-#endif /* CONFIG_DIAG_RESET_REASON || CONFIG_DIAG_RESET_CONTEXT_RUNTIME */
+#endif /* CONFIG_DIAG_RESET_REASON || CONFIG_DIAG_RESET_CONTEXT_RUNTIME || CONFIG_METRICS */
 
     switch (caniot_attr_key_get_root(key)) {
 #if CONFIG_CANIOT_DEVICE_STARTUP_ATTRIBUTES
@@ -193,6 +210,13 @@ static int attr_read(struct caniot_device *dev, uint16_t key, uint32_t *val)
         break;
 #endif /* CONFIG_DIAG_RESET_CONTEXT_PERSISTENT */
 #endif /* CONFIG_DIAG */
+#if CONFIG_METRICS
+    case DEV_ATTR_KEY_METRICS:
+        if (metrics_read(key_part, val) != 0) {
+            ret = -CANIOT_ENOTSUP;
+        }
+        break;
+#endif /* CONFIG_METRICS */
     default:
         ret = -CANIOT_ENOTSUP;
         break;
@@ -206,6 +230,11 @@ static int attr_write(struct caniot_device *dev, uint16_t key, uint32_t val)
     int ret = 0;
 
     switch (key) {
+#if CONFIG_METRICS
+    case DEV_ATTR_KEY_METRICS:
+        if (val != 0) metrics_reset();
+        break;
+#endif /* CONFIG_METRICS */
 #if CONFIG_DIAG
 #if CONFIG_DIAG_RESET_CONTEXT_PERSISTENT
     case CANIOT_ATTR_KEY_DIAG_RESET_COUNT:
@@ -364,7 +393,7 @@ bool dev_telemetry_is_requested(void)
 void dev_trigger_telemetry(caniot_endpoint_t ep)
 {
     caniot_device_trigger_telemetry_ep(&device, ep);
-    dev_trigger_process();
+    dev_trigger_process_event(DEV_EVENT_TELEMETRY);
 }
 
 void dev_trigger_telemetrys(uint8_t endpoints_bitmask)
@@ -375,7 +404,7 @@ void dev_trigger_telemetrys(uint8_t endpoints_bitmask)
         }
     }
 
-    dev_trigger_process();
+    dev_trigger_process_event(DEV_EVENT_TELEMETRY);
 }
 
 static int dev_inhibit(struct caniot_device *dev)
@@ -456,8 +485,18 @@ static const struct caniot_device_id identification[CONFIG_DEVICE_INSTANCES_COUN
 
 static struct caniot_device devices[CONFIG_DEVICE_INSTANCES_COUNT] = {0u};
 static uint8_t current_device_index                                = 0u;
-static struct caniot_frame devices_rx_frames[CONFIG_DEVICE_INSTANCES_COUNT];
-static uint8_t devices_rx_frames_status = 0u;
+
+/* Received frames waiting to be processed by their instance, each instance
+ * has a FIFO of frames linked in a pool shared by all instances.
+ */
+#define RX_POOL_NONE 0xFFu
+
+static struct caniot_frame rx_pool[CONFIG_DEVICE_MULTI_RX_POOL_SIZE];
+static uint8_t rx_pool_next[CONFIG_DEVICE_MULTI_RX_POOL_SIZE];
+static uint8_t rx_pool_free = RX_POOL_NONE;
+static uint8_t rx_fifo_head[CONFIG_DEVICE_INSTANCES_COUNT];
+static uint8_t rx_fifo_tail[CONFIG_DEVICE_INSTANCES_COUNT];
+static uint8_t rx_pending = 0u; /* Bitmask of instances with queued frames */
 
 static int multi_caniot_recv(struct caniot_frame *frame);
 
@@ -482,6 +521,11 @@ void dev_init(void)
         caniot_app_init(dev);
         settings_init(dev, &default_config[i]);
     }
+
+    for (uint8_t i = 0u; i < CONFIG_DEVICE_MULTI_RX_POOL_SIZE; i++) {
+        rx_pool_next[i] = rx_pool_free;
+        rx_pool_free    = i;
+    }
 }
 
 void dev_print_indentification(void)
@@ -498,53 +542,133 @@ uint8_t dev_get_instance_index(struct caniot_device *dev)
     return dev - devices;
 }
 
-static int multi_caniot_recv(struct caniot_frame *frame)
+static void rx_fifo_push(uint8_t device_index)
 {
-    /* We use provided buffer to store the received frame so that
-     * we save 1 copy operation in case the frame matches the device being
-     * processed.
-     * If the frame does not match the device being processed, we then copy it
-     * to the device frame buffer and return -EAGAIN.
-     */
-    int ret = platform_caniot_recv(frame);
+    const uint8_t slot = rx_pool_free;
+
+    rx_pool_free       = rx_pool_next[slot];
+    rx_pool_next[slot] = RX_POOL_NONE;
+
+    /* Convert the frame directly into the pool slot */
+    (void)platform_caniot_recv(&rx_pool[slot]);
+
+    if (rx_pending & BIT(device_index)) {
+        rx_pool_next[rx_fifo_tail[device_index]] = slot;
+    } else {
+        rx_fifo_head[device_index] = slot;
+        rx_pending |= BIT(device_index);
+    }
+    rx_fifo_tail[device_index] = slot;
+}
+
+static void rx_fifo_pop(uint8_t device_index, struct caniot_frame *frame)
+{
+    const uint8_t slot = rx_fifo_head[device_index];
+
+    memcpy(frame, &rx_pool[slot], sizeof(*frame));
+
+    rx_fifo_head[device_index] = rx_pool_next[slot];
+    if (rx_fifo_head[device_index] == RX_POOL_NONE) {
+        rx_pending &= ~BIT(device_index);
+    }
+
+    rx_pool_next[slot] = rx_pool_free;
+    rx_pool_free       = slot;
+}
+
+/* Peek the index of the instance addressed by the frame at the head of the
+ * CAN RX ring, the index is out of range if the SID is not served.
+ */
+static int rx_peek_index(uint8_t *device_index)
+{
+    uint8_t sid;
+
+    int ret = platform_caniot_recv_peek_sid(&sid);
     if (ret == 0) {
-        /* We are sure the received frame is of the current class
-         * because class filtering is done by the CAN driver.
-         */
-        const uint8_t device_index = frame->id.sid;
+        *device_index = (uint8_t)(sid - CONFIG_DEVICE_MULTI_FIRST_SID);
+    }
 
-        /* if we received a frame for another device, we copy it to the device
-         * frame buffer, set frame presence flag and return -EAGAIN.
-         */
-        if (device_index != current_device_index) {
-            ret = -CANIOT_EAGAIN;
-
-            /* Check the device id is in supported range */
-            if (device_index < CONFIG_DEVICE_INSTANCES_COUNT) {
-                /* make sure the frame slot is empty for the device */
-                if (devices_rx_frames_status & BIT(device_index)) {
-                    LOG_ERR("device %u frame slot not empty, dropping ...", device_index);
-                }
-
-                /* Write frame to device frame buffer */
-                memcpy(&devices_rx_frames[device_index], frame, sizeof(*frame));
-                devices_rx_frames_status |= BIT(device_index);
-            }
+    return ret;
+}
+
+/* Dispatch the received frames to the instances FIFOs.
+ *
+ * Dispatching stops (returning 0) at the first frame for the instance
+ * "direct_index", so that the frame can be converted directly from the CAN RX
+ * ring to the caller buffer. Only the frames for the other instances are
+ * queued to the pool.
+ *
+ * We are sure the received frames are of the current class
+ * because class filtering is done by the CAN driver.
+ */
+static int rx_dispatch(uint8_t direct_index)
+{
+    int ret;
+    uint8_t device_index;
+
+    while ((ret = rx_peek_index(&device_index)) == 0) {
+        if (device_index == direct_index) {
+            break;
+        } else if (device_index >= CONFIG_DEVICE_INSTANCES_COUNT) {
+            /* Device id not in supported range */
+            platform_caniot_recv_drop();
+        } else if (rx_pool_free == RX_POOL_NONE) {
+            LOG_ERR("device %u rx pool full, dropping ...", device_index);
+            platform_caniot_recv_drop();
+        } else {
+            rx_fifo_push(device_index);
         }
-    } else if (ret == -CANIOT_EAGAIN) {
-        /* If we did not receive a frame, we check if we have a frame stored for the
-         * current device.
-         */
-        if (devices_rx_frames_status & BIT(current_device_index)) {
-            memcpy(frame, &devices_rx_frames[current_device_index], sizeof(*frame));
-            devices_rx_frames_status &= ~BIT(current_device_index);
-            ret = 0;
+    }
+
+    return ret;
+}
+
+static int multi_caniot_recv(struct caniot_frame *frame)
+{
+    int ret;
+
+    /* Frames queued for the instance are older than the ones still in the
+     * CAN RX ring, serve them first whatever the state of the ring.
+     */
+    if (rx_pending & BIT(current_device_index)) {
+        rx_fifo_pop(current_device_index, frame);
+        ret = 0;
+    } else {
+        ret = rx_dispatch(current_device_index);
+        if (ret == 0) {
+            ret = platform_caniot_recv(frame);
         }
     }
 
     return ret;
 }
 
+/* Bitmask of instances having frames to process: the ones with frames queued
+ * and the one addressed by the frame at the head of the CAN RX ring.
+ */
+static uint8_t rx_ready_map(int *err)
+{
+    int ret;
+    uint8_t device_index;
+    uint8_t map = rx_pending;
+
+    while ((ret = rx_peek_index(&device_index)) == 0) {
+        if (device_index < CONFIG_DEVICE_INSTANCES_COUNT) {
+            map |= BIT(device_index);
+            break;
+        }
+
+        /* Device id not in supported range */
+        platform_caniot_recv_drop();
+    }
+
+    if (err != NULL) {
+        *err = ret;
+    }
+
+    return map;
+}
+
 static inline uint8_t next_index(uint8_t index, uint8_t en_map)
 {
     for (uint8_t i = 0u; i < CONFIG_DEVICE_INSTANCES_COUNT; i++) {
@@ -557,24 +681,46 @@ static inline uint8_t next_index(uint8_t index, uint8_t en_map)
     return index;
 }
 
+/* Bitmask of instances having telemetry to send */
+static uint8_t telemetry_due_map(void)
+{
+    uint8_t map = 0u;
+
+    for (uint8_t i = 0u; i < CONFIG_DEVICE_INSTANCES_COUNT; i++) {
+        if ((caniot_device_time_until_process(&devices[i]) == 0u) ||
+            caniot_device_triggered_telemetry_any(&devices[i])) {
+            map |= BIT(i);
+        }
+    }
+
+    return map;
+}
+
 int dev_process(uint8_t tid)
 {
-    /* Bitmask of devices to process
-     * When calling dev_process() for the first time, we need to process
-     * all devices at least once.
+    int ret;
+    uint8_t rx_map = rx_ready_map(&ret);
+    if ((ret != 0) && (ret != -CANIOT_EAGAIN)) {
+        caniot_show_error(ret);
+    }
+
+    /* Bitmask of devices to process, only instances with received frames or
+     * telemetry to send are processed.
      */
-    uint8_t do_run_map = (1u << CONFIG_DEVICE_INSTANCES_COUNT) - 1u;
+    uint8_t do_run_map = rx_map | telemetry_due_map();
 
-    /* Set current_device_index to a value that will be incremented to the
-     * first device to process.
+    /* Instances which failed are not processed again during this call, so
+     * that a persistent error cannot keep the loop (and the watchdog) running
+     * forever. Their remaining frames are served by the next call, at the
+     * latest after the process interval.
      */
-    current_device_index = CONFIG_DEVICE_INSTANCES_COUNT - 1u;
+    uint8_t failed_map = 0u;
 
-    do {
+    while (do_run_map) {
         /* Select next device to process */
         current_device_index = next_index(current_device_index, do_run_map);
 
-        int ret = caniot_device_process(&devices[current_device_index]);
+        ret = caniot_device_process(&devices[current_device_index]);
         if (ret == 0) {
             // reprocess the device after
         } else if (ret == -CANIOT_EAGAIN) { // no frame received for the device
@@ -582,8 +728,15 @@ int dev_process(uint8_t tid)
             do_run_map &= ~BIT(current_device_index);
         } else { // on error
             caniot_show_error(ret);
+            failed_map |= BIT(current_device_index);
+            do_run_map &= ~BIT(current_device_index);
         }
 
+        /* Devices which got a frame queued or at the head of the RX ring
+         * meanwhile need to be processed
+         */
+        do_run_map |= rx_ready_map(NULL) & ~failed_map;
+
 #if CONFIG_WATCHDOG
         /* I'm alive ! */
         alive(tid);
@@ -591,7 +744,7 @@ int dev_process(uint8_t tid)
 
         /* Yield to allow other threads to run */
         k_yield();
-    } while (do_run_map);
+    }
 
     return 0;
 }
@@ -630,7 +783,7 @@ void dev_trigger_telemetry(caniot_endpoint_t ep)
         caniot_device_trigger_telemetry_ep(&devices[i], ep);
     }
 
-    dev_trigger_process();
+    dev_trigger_process_event(DEV_EVENT_TELEMETRY);
 }
 
 void dev_trigger_telemetrys(uint8_t endpoints_bitmask)
@@ -644,7 +797,7 @@ void dev_trigger_telemetrys(uint8_t endpoints_bitmask)
         }
     }
 
-    dev_trigger_process();
+    dev_trigger_process_event(DEV_EVENT_TELEMETRY);
 }
 
 static int dev_inhibit(struct caniot_device *dev)
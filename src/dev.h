@@ -12,6 +12,7 @@
 #include <avrtos/avrtos.h>
 
 #include <caniot/caniot.h>
+#include <util/atomic.h>
 #include <caniot/datatype.h>
 #include <caniot/device.h>
 
@@ -25,6 +26,11 @@ extern "C" {
 
 #define DEVICE_CLASS __DEVICE_CLS__
 
+/* Device specific attribute keys, in a range not used by caniot-lib
+ * (CANIOT_ATTR_KEY_*), the key part selects the item.
+ */
+#define DEV_ATTR_KEY_METRICS 0x3F00u /* see metrics.h */
+
 /**
  * @brief Print the device CANIOT identification.
  */
@@ -94,22 +100,58 @@ int dev_apply_blc_sys_command(struct caniot_device *dev,
                               struct caniot_blc_sys_command *sysc);
 
 /**
- * @brief Signal used to trigger the device process.
+ * @brief Sources of work for the main thread, only the components having work
+ * are run when the main thread wakes up.
+ */
+#define DEV_EVENT_CAN       BIT(0u) /* CAN frame(s) received */
+#define DEV_EVENT_TELEMETRY BIT(1u) /* Telemetry requested */
+#define DEV_EVENT_APP       BIT(2u) /* Application processing requested */
+
+/**
+ * @brief Signal used to wake up the main thread.
  */
 extern struct k_signal dev_process_sig;
 
 /**
- * @brief Trigger the device process.
+ * @brief Pending main thread work (DEV_EVENT_* bitmask).
+ */
+extern volatile uint8_t dev_events;
+
+/**
+ * @brief Trigger the main thread for the given sources of work.
  *
  * This function must be inlined as it is often called from an ISR.
  *
- * @return struct k_thread*
+ * @param events DEV_EVENT_* bitmask
+ * @return int8_t
  */
-static inline int8_t dev_trigger_process(void)
+static inline int8_t dev_trigger_process_event(uint8_t events)
 {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        dev_events |= events;
+    }
+
     return k_signal_raise(&dev_process_sig, 0);
 }
 
+/**
+ * @brief Trigger the device process.
+ *
+ * @return int8_t
+ */
+static inline int8_t dev_trigger_process(void)
+{
+    return dev_trigger_process_event(DEV_EVENT_CAN);
+}
+
+/**
+ * @brief Get and clear the pending main thread work.
+ *
+ * @return uint8_t DEV_EVENT_* bitmask
+ */
+uint8_t dev_events_take(void);
+
 /* Utility functions */
 
 /**
@@ -7,14 +7,15 @@
 #if CONFIG_GPIO_PULSE_SUPPORT
 
 #include "bsp/bsp.h"
+#include "dev.h"
 #include "devices/gpio_pulse.h"
 
 #include <stdbool.h>
 
 #include <avrtos/avrtos.h>
-#include <avrtos/dstruct/tqueue.h>
 
 #include <avr/io.h>
+#include <util/atomic.h>
 
 #define K_MODULE K_MODULE_APPLICATION
 
@@ -22,34 +23,26 @@
 #error CONFIG_GPIO_PULSE_SIMULTANEOUS_COUNT == 0 while PULSE support is enabled
 #endif
 
-static uint32_t pulse_last_process = 0u;
+#if !CONFIG_KERNEL_EVENTS
+#error "Pulse support needs CONFIG_KERNEL_EVENTS to be set"
+#endif
 
 K_MEM_SLAB_DEFINE(ctx_mems,
                   sizeof(struct pulse_event),
                   CONFIG_GPIO_PULSE_SIMULTANEOUS_COUNT);
 
-static DEFINE_TQUEUE(ev_queue);
-
-#if CONFIG_GPIO_PULSE_THREAD_SAFE
-static K_MUTEX_DEFINE(mutex);
-#define PULSE_CONTEXT_LOCK()   k_mutex_lock(&mutex, K_FOREVER)
-#define PULSE_CONTEXT_UNLOCK() k_mutex_unlock(&mutex)
-#else
-#define PULSE_CONTEXT_LOCK()
-#define PULSE_CONTEXT_UNLOCK()
-#endif
-
-#define EVENT_FROM_TIE(tie_p) CONTAINER_OF(tie_p, struct pulse_event, _tie)
-
-#define EVENT_TO_PIN(ev) (ev - events)
-
 static struct pulse_event *alloc_context(void)
 {
     void *mem;
 
     if (k_mem_slab_alloc(&ctx_mems, &mem, K_NO_WAIT) == 0) {
-        ((struct pulse_event *)mem)->_iallocated = 1u;
-        return mem;
+        struct pulse_event *const ev = mem;
+
+        ev->scheduled   = 0u;
+        ev->_ending     = 0u;
+        ev->_iallocated = 1u;
+        ev->owner       = NULL;
+        return ev;
     }
 
     return NULL;
@@ -58,6 +51,13 @@ static struct pulse_event *alloc_context(void)
 static void free_context(struct pulse_event *ctx)
 {
     if (ctx->_iallocated) {
+        /* the context may be reused for another pin, unless the owner
+         * already moved to a new context
+         */
+        if ((ctx->owner != NULL) && (*ctx->owner == ctx)) {
+            *ctx->owner = NULL;
+        }
+
         k_mem_slab_free(&ctx_mems, (void *)ctx);
     }
 }
@@ -67,24 +67,60 @@ static inline void output_set_state(pin_descr_t descr, bool state)
     bsp_descr_gpio_output_write(descr, state ? GPIO_HIGH : GPIO_LOW);
 }
 
-/**
- * @brief Assume event is not null
- *
- * @param ev
+/* Write a native GPIO pin directly from its port registers, without going
+ * through the generic descriptor resolution (which logs). Interrupts must be
+ * disabled by the caller.
  */
-static void cancel_event(struct pulse_event *ev)
+static inline void native_output_set_state(pin_descr_t descr, bool state)
 {
-    __ASSERT_NOTNULL(ev);
+    GPIO_Device *const gpio = BSP_DESCR_DEVICE_GET(descr);
+    const uint8_t mask      = _BV(BSP_DESCR_GPIO_PIN_GET(descr));
 
-    if (ev->scheduled == 1U) {
-        tqueue_remove(&ev_queue, &ev->_tie);
-        ev->scheduled = 0U;
+    if (state) {
+        gpio->PORT |= mask;
+    } else {
+        gpio->PORT &= ~mask;
     }
 }
 
-void pulse_init(void)
+static void pulse_work_handler(struct k_work *work)
 {
-    pulse_last_process = k_uptime_get();
+    struct pulse_event *const ev = CONTAINER_OF(work, struct pulse_event, _work);
+    bool release;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        ev->_ending = 0u;
+        release     = (ev->scheduled == 0u);
+    }
+
+    /* Unless the pulse was triggered again meanwhile, (re)write the reset
+     * state: extended IOs are only written here and a native pin reset from
+     * the ISR may have been overwritten by a read-modify-write of its port
+     * interrupted in thread context.
+     */
+    if (release) {
+        output_set_state(ev->descr, ev->reset_state);
+        bsp_gpio_commit();
+        free_context(ev);
+    }
+
+    dev_trigger_telemetry(CANIOT_ENDPOINT_BOARD_CONTROL);
+}
+
+/* Called from the sysclock ISR at the end of the pulse */
+static void pulse_event_handler(struct k_event *kev)
+{
+    struct pulse_event *const ev = CONTAINER_OF(kev, struct pulse_event, _ev);
+
+    ev->scheduled = 0u;
+    ev->_ending   = 1u;
+
+    if (BSP_DESCR_IS_NATIVE_GPIO(ev->descr)) {
+        native_output_set_state(ev->descr, ev->reset_state);
+    }
+
+    k_system_workqueue_submit(&ev->_work);
 }
 
 struct pulse_event *
@@ -101,17 +137,30 @@ pulse_trigger(pin_descr_t descr, bool state, uint32_t duration_ms, struct pulse_
         ev->_iallocated = 0u;
     }
 
-    PULSE_CONTEXT_LOCK();
-
     if (ev != NULL) {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            if (ev->scheduled) {
+                k_event_cancel(&ev->_ev);
+            }
+
+            /* Completion of a previous pulse still queued, it will find
+             * the context scheduled again and leave it untouched.
+             */
+            if (!ev->_ending) {
+                k_work_init(&ev->_work, pulse_work_handler);
+            }
+
+            ev->scheduled   = 1u;
+            ev->descr       = descr;
+            ev->reset_state = !state;
+        }
+
         output_set_state(descr, state);
-        ev->scheduled   = 1u;
-        ev->descr       = descr;
-        ev->reset_state = !state;
-        tqueue_schedule(&ev_queue, &ev->_tie, duration_ms);
-    }
 
-    PULSE_CONTEXT_UNLOCK();
+        k_event_init(&ev->_ev, pulse_event_handler);
+        k_event_schedule(&ev->_ev, K_MSEC(duration_ms));
+    }
 
 exit:
     return ev;
@@ -119,67 +168,40 @@ exit:
 
 void pulse_cancel(struct pulse_event *ev, bool do_reset_state)
 {
-    PULSE_CONTEXT_LOCK();
+    bool release = false;
 
-    if (ev != NULL) {
-        cancel_event(ev);
-        if (do_reset_state) output_set_state(ev->descr, ev->reset_state);
-        free_context(ev);
+    if (ev == NULL) {
+        return;
     }
 
-    PULSE_CONTEXT_UNLOCK();
-}
-
-bool pulse_is_active(struct pulse_event *ev)
-{
-    if (ev != NULL) {
-        return ev->scheduled == 1U;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (ev->scheduled == 1u) {
+            k_event_cancel(&ev->_ev);
+            ev->scheduled = 0u;
+
+            /* Unless a completion is still queued (pulse triggered again
+             * meanwhile), the context is owned by the pulse
+             */
+            release = (ev->_ending == 0u);
+        }
     }
 
-    return false;
-}
-
-bool pulse_process(uint32_t now_ms)
-{
-    struct titem *_tie = NULL;
-    bool least_one     = false;
-
-    PULSE_CONTEXT_LOCK();
-
-    /* Time passed since last process */
-    uint32_t time_passed_ms = now_ms - pulse_last_process;
-    pulse_last_process      = now_ms;
+    if (do_reset_state) output_set_state(ev->descr, ev->reset_state);
 
-    tqueue_shift(&ev_queue, time_passed_ms);
-
-    while ((_tie = tqueue_pop(&ev_queue)) != NULL) {
-        struct pulse_event *ev = EVENT_FROM_TIE(_tie);
-
-        ev->scheduled = 0U;
-        output_set_state(ev->descr, ev->reset_state);
+    /* Contexts of ended pulses are released by the workqueue */
+    if (release) {
         free_context(ev);
-
-        least_one = true;
     }
-
-    PULSE_CONTEXT_UNLOCK();
-
-    return least_one;
 }
 
-uint32_t pulse_remaining(void)
+bool pulse_is_active(struct pulse_event *ev)
 {
-    uint32_t remaining = -1;
-
-    PULSE_CONTEXT_LOCK();
-
-    if (ev_queue != NULL) {
-        remaining = ev_queue->timeout;
+    if (ev != NULL) {
+        return ev->scheduled == 1U;
     }
 
-    PULSE_CONTEXT_UNLOCK();
-
-    return remaining;
+    return false;
 }
 
-#endif
\ No newline at end of file
+#endif
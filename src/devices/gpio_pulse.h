@@ -6,7 +6,12 @@
 
 /**
  * @brief Pulse API for generating simple pulses on output pins.
- * 	- Thread-safe. if CONFIG_GPIO_PULSE_THREAD_SAFE is set to 1
+ *
+ * Each pulse owns a kernel event, the end of the pulse is handled from the
+ * sysclock interrupt at its deadline (1 ms resolution). Native GPIOs are
+ * reset directly from the interrupt, extended IOs (I2C) are reset from the
+ * system workqueue. No lock is taken, pulses can be triggered and cancelled
+ * from any thread.
  */
 
 #ifndef _GPIO_PULSE_H_
@@ -17,10 +22,14 @@
 #include <stdbool.h>
 #include <stdint.h>
 
-#define CONFIG_GPIO_PULSE_THREAD_SAFE 1u
+#include <avrtos/avrtos.h>
 
 struct pulse_event {
-    struct titem _tie;
+    /* Fires at the end of the pulse (ISR context) */
+    struct k_event _ev;
+
+    /* Completes the end of the pulse in thread context */
+    struct k_work _work;
 
     /* State of the pin when not active */
     uint8_t reset_state : 1;
@@ -28,25 +37,33 @@ struct pulse_event {
     /* Tells wether the pulse is active or not */
     uint8_t scheduled : 1;
 
+    /* Pulse ended, completion pending in the workqueue */
+    uint8_t _ending : 1;
+
     /* Tells wether the pulse context has been allocated using the
      * pulse allocator or not */
     uint8_t _iallocated : 1;
 
     /* GPIO descriptor */
     pin_descr_t descr;
-};
 
-/**
- * @brief Init pulse module
- */
-void pulse_init(void);
+    /* Handle to the context, cleared when an allocated context is released */
+    struct pulse_event **owner;
+};
 
 /**
  * @brief Trigger a pulse on an output
  *
- * @warning If a pulse is already pending on the pin, it WON'T be CANCELLED, so bot pulses
- * will be processed simultaneously. If you don't want this behavior, you should
- * call pulse_cancel() before calling pulse_trigger().
+ * If a context is provided and its pulse is still active, the pulse is
+ * restarted with the new state and duration. With a NULL context, a new
+ * context is allocated and a pulse already active on the pin is not
+ * cancelled, call pulse_cancel() first with its context.
+ *
+ * An allocated context is released when its pulse ends or is cancelled, the
+ * caller keeping it must set the "owner" field to its handle (before
+ * yielding) so that the handle is cleared at that time.
+ *
+ * A board control telemetry is triggered when the pulse ends.
  *
  * @param output RL1, RL2, OC1, OC2
  * @param state true, false
@@ -73,19 +90,4 @@ void pulse_cancel(struct pulse_event *ev, bool do_reset_state);
  */
 bool pulse_is_active(struct pulse_event *ev);
 
-/**
- * @brief Handle pulses if any
- *
- * @param time_passed_ms
- * @return true if at least one pulse was processed
- */
-bool pulse_process(uint32_t now_ms);
-
-/**
- * @brief Get time until next event
- *
- * @return uint32_t
- */
-uint32_t pulse_remaining(void);
-
-#endif /* _GPIO_PULSE_H_ */
\ No newline at end of file
+#endif /* _GPIO_PULSE_H_ */
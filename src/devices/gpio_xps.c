@@ -48,6 +48,10 @@ int command_xps(struct xps_context *xpsc,
         pulse_cancel(xpsc->pev, false);
         xpsc->pev =
             pulse_trigger(xpsc->descr, cmd == CANIOT_XPS_PULSE_ON, duration_ms, NULL);
+        if (xpsc->pev != NULL) {
+            /* cleared when the pulse context is released */
+            xpsc->pev->owner = &xpsc->pev;
+        }
 
         LOG_DBG("XPS: descr=%u pev=%p rest=%u cmd=%u dur=%lu",
                 xpsc->descr,
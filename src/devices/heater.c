@@ -128,6 +128,7 @@ void heater_ev_cb(struct k_event *ev)
     heater->active       = to_activate; /* Update state */
     heater_set_active(pos, active);
     heater_set_active(neg, active);
+    bsp_gpio_commit();
 
     /* Reschedule the event */
     k_event_schedule(ev, K_MSEC(next_timeout_ms));
@@ -221,6 +222,9 @@ int heater_set_mode(uint8_t hid, heater_mode_t mode)
         return -EINVAL;
     }
 
+    /* Both pilot wire phases switch at once */
+    bsp_gpio_commit();
+
     hs[hid].mode = mode;
 
     return 0;
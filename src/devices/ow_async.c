@@ -0,0 +1,262 @@
+/*
+ * Copyright (c) 2024 Lucas Dietrich <ld.adecy@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Slot timings are the ones of the Arduino OneWire library (see ow_ds_drv.cpp),
+ * except for the write 1 low time (6 us, the recommended standard speed value).
+ * Only the edges which must be placed within a few us (write 1 release, read
+ * sample) are busy-waited in the interrupt, the longest wait being the 13 us of
+ * a read slot. Everything else is scheduled on the timer.
+ *
+ * Presence detection: the sensors answer the reset 15-60 us after the bus is
+ * released with a 60-240 us low pulse, so the bus is always low between 60 us
+ * and 75 us. The sample is scheduled at 64 us, as the compare interrupt can be
+ * delayed by other interrupts the actual time of the sample is checked: a high
+ * bus sampled too late is not a reliable absence and the reset is retried.
+ */
+
+#include "ow_async.h"
+
+#if CONFIG_OW_ASYNC
+
+#include <errno.h>
+
+#include <avrtos/avrtos.h>
+
+#include <Arduino.h>
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+#include <util/delay.h>
+
+/* timer 0 runs with a prescaler of 64 (see bsp hw_ll_init()) */
+#define OW_TICKS(_us)       ((uint8_t)(((_us) * (F_CPU / 1000000lu) + 63u) / 64u))
+#define OW_TICKS_FLOOR(_us) ((uint8_t)(((_us) * (F_CPU / 1000000lu)) / 64u))
+
+/* The compare may match up to one tick early and the elapsed time measured
+ * from TCNT0 is one tick off at most.
+ */
+#define PRESENCE_SAMPLE_TICKS (OW_TICKS(60u) + 1u)
+#define PRESENCE_LATEST_TICKS (OW_TICKS_FLOOR(75u) - 1u)
+
+/* Resets retried when the presence sample was taken too late */
+#define PRESENCE_RETRIES 2u
+
+#if PRESENCE_SAMPLE_TICKS > PRESENCE_LATEST_TICKS
+#error "OneWire presence sampling window too narrow for the timer 0 resolution"
+#endif
+
+#if OW_TICKS(480u) > 250u
+#error "OneWire reset pulse does not fit in a timer 0 compare period"
+#endif
+
+enum {
+    STATE_IDLE = 0u,
+    STATE_RESET_RELEASE,
+    STATE_RESET_SAMPLE,
+    STATE_SLOT,
+    STATE_WRITE0_RELEASE,
+};
+
+static struct {
+    volatile uint8_t *reg_in;
+    volatile uint8_t *reg_mode;
+    volatile uint8_t *reg_out;
+    uint8_t mask;
+
+    struct ow_async_xfer xfer;
+    ow_async_cb_t cb;
+    void *user_data;
+
+    volatile uint8_t state;
+    uint8_t index;     /* byte index, tx bytes then rx bytes */
+    uint8_t bit;       /* bit mask in the current byte, LSB first */
+    uint8_t released;  /* TCNT0 when the reset pulse was released */
+    uint8_t retries;   /* resets left if the presence sample is late */
+} ow;
+
+static inline void bus_low(void)
+{
+    *ow.reg_out &= ~ow.mask;
+    *ow.reg_mode |= ow.mask;
+}
+
+static inline void bus_release(void)
+{
+    *ow.reg_mode &= ~ow.mask;
+}
+
+static inline void bus_high(void)
+{
+    *ow.reg_out |= ow.mask;
+    *ow.reg_mode |= ow.mask;
+}
+
+static inline uint8_t bus_read(void)
+{
+    return (*ow.reg_in & ow.mask) ? 1u : 0u;
+}
+
+static inline void next_bit(void)
+{
+    ow.bit <<= 1u;
+    if (ow.bit == 0u) {
+        ow.bit = 1u;
+        ow.index++;
+    }
+}
+
+/* Start the next slot, return the ticks before the next step or 0 if done */
+static uint8_t slot_start(void)
+{
+    const uint8_t tx_len = ow.xfer.tx_len;
+
+    if (ow.index < tx_len) {
+        bus_low();
+        if (ow.xfer.tx[ow.index] & ow.bit) {
+            _delay_us(6);
+            bus_release();
+            next_bit();
+            return OW_TICKS(59u);
+        } else {
+            ow.state = STATE_WRITE0_RELEASE;
+            return OW_TICKS(65u);
+        }
+    } else if (ow.index < tx_len + ow.xfer.rx_len) {
+        uint8_t *const byte = &ow.xfer.rx[ow.index - tx_len];
+
+        bus_low();
+        _delay_us(3);
+        bus_release();
+        _delay_us(10);
+        if (bus_read()) {
+            *byte |= ow.bit;
+        } else {
+            *byte &= ~ow.bit;
+        }
+        next_bit();
+        return OW_TICKS(53u);
+    }
+
+    if (ow.xfer.power) {
+        bus_high();
+    }
+
+    return 0u;
+}
+
+/* Run one step of the state machine, return the ticks before the next step
+ * or 0 once the transfer is complete (status updated accordingly)
+ */
+static uint8_t step(int8_t *status)
+{
+    switch (ow.state) {
+    case STATE_IDLE:
+        /* first step: reset pulse */
+        bus_low();
+        ow.state = STATE_RESET_RELEASE;
+        return OW_TICKS(480u);
+    case STATE_RESET_RELEASE:
+        bus_release();
+        ow.released = TCNT0;
+        ow.state    = STATE_RESET_SAMPLE;
+        return PRESENCE_SAMPLE_TICKS;
+    case STATE_RESET_SAMPLE:
+    {
+        const uint8_t elapsed = TCNT0 - ow.released;
+
+        if (bus_read()) {
+            if ((elapsed > PRESENCE_LATEST_TICKS) && ow.retries) {
+                /* sampled too late, the presence pulse may be over */
+                ow.retries--;
+                bus_low();
+                ow.state = STATE_RESET_RELEASE;
+                return OW_TICKS(480u);
+            }
+
+            /* no presence pulse */
+            *status = -ENODEV;
+            return 0u;
+        }
+
+        /* complete the 480 us presence detection time slot */
+        ow.state = STATE_SLOT;
+        return (elapsed < OW_TICKS(480u)) ? OW_TICKS(480u) - elapsed : 1u;
+    }
+    case STATE_WRITE0_RELEASE:
+        /* recovery time before the next slot */
+        bus_release();
+        next_bit();
+        ow.state = STATE_SLOT;
+        return OW_TICKS(5u);
+    case STATE_SLOT:
+    default:
+        return slot_start();
+    }
+}
+
+ISR(TIMER0_COMPB_vect)
+{
+    int8_t status      = 0;
+    const uint8_t next = step(&status);
+
+    if (next != 0u) {
+        OCR0B = TCNT0 + next;
+    } else {
+        TIMSK0 &= ~BIT(OCIE0B);
+        ow.state = STATE_IDLE;
+        ow.cb(status, ow.user_data);
+    }
+}
+
+void ow_async_init(uint8_t pin)
+{
+    const uint8_t port = digitalPinToPort(pin);
+
+    ow.mask     = digitalPinToBitMask(pin);
+    ow.reg_in   = portInputRegister(port);
+    ow.reg_mode = portModeRegister(port);
+    ow.reg_out  = portOutputRegister(port);
+
+    /* Normal mode: in fast PWM mode OCR0B is double buffered (only updated at
+     * the overflow), which prevents scheduling the slots. The overflow period
+     * (hence millis()) is the same as in fast PWM mode, but the PWM outputs of
+     * timer 0 (OC0A/OC0B, analogWrite() on D6/D5) are no longer available.
+     */
+    TCCR0A &= ~(BIT(WGM01) | BIT(WGM00));
+}
+
+int8_t ow_async_submit(const struct ow_async_xfer *xfer, ow_async_cb_t cb, void *user_data)
+{
+    int8_t ret = -EBUSY;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if ((TIMSK0 & BIT(OCIE0B)) == 0u) {
+            ow.xfer      = *xfer;
+            ow.cb        = cb;
+            ow.user_data = user_data;
+            ow.index     = 0u;
+            ow.bit       = 1u;
+            ow.retries   = PRESENCE_RETRIES;
+            ow.state     = xfer->reset ? STATE_IDLE : STATE_SLOT;
+
+            TIFR0 = BIT(OCF0B);
+            OCR0B = TCNT0 + 2u;
+            TIMSK0 |= BIT(OCIE0B);
+
+            ret = 0;
+        }
+    }
+
+    return ret;
+}
+
+uint8_t ow_async_busy(void)
+{
+    return (TIMSK0 & BIT(OCIE0B)) ? 1u : 0u;
+}
+
+#endif /* CONFIG_OW_ASYNC */
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2024 Lucas Dietrich <ld.adecy@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @brief Interrupt driven OneWire engine
+ *
+ * Reset, write and read slots are sequenced from the timer 0 compare B
+ * interrupt, the CPU is released between two slots. Only the few microseconds
+ * critical parts of a slot are busy-waited in the ISR.
+ */
+
+#ifndef _OW_ASYNC_H_
+#define _OW_ASYNC_H_
+
+#include "config.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Completion callback, called from the ISR context
+ *
+ * @param status 0 on success, -ENODEV if no presence pulse was detected
+ * @param user_data
+ */
+typedef void (*ow_async_cb_t)(int8_t status, void *user_data);
+
+struct ow_async_xfer {
+    /* Bytes to write, then bytes to read */
+    const uint8_t *tx;
+    uint8_t *rx;
+    uint8_t tx_len;
+    uint8_t rx_len;
+
+    /* Start with a reset and presence detection */
+    uint8_t reset : 1;
+
+    /* Drive the bus high at the end of the transfer (parasite power) */
+    uint8_t power : 1;
+};
+
+/**
+ * @brief Initialize the engine on the given (arduino) pin and switch timer 0
+ * to normal mode (overflow period unchanged, but the timer 0 PWM outputs
+ * OC0A/OC0B can't be used anymore).
+ *
+ * @param pin
+ */
+void ow_async_init(uint8_t pin);
+
+/**
+ * @brief Start a transfer, buffers must remain valid until completion
+ *
+ * @param xfer Transfer descriptor (copied)
+ * @param cb Completion callback (ISR context)
+ * @param user_data
+ * @return int8_t 0 on success, -EBUSY if a transfer is already in progress
+ */
+int8_t ow_async_submit(const struct ow_async_xfer *xfer, ow_async_cb_t cb, void *user_data);
+
+/**
+ * @brief Indicates whether a transfer is in progress
+ */
+uint8_t ow_async_busy(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _OW_ASYNC_H_ */
@@ -12,6 +12,7 @@
  */
 
 #include "../bsp/bsp.h"
+#include "ow_async.h"
 #include "ow_ds_drv.h"
 
 #include <avrtos/avrtos.h>
@@ -24,6 +25,21 @@
 #define LOG_LEVEL LOG_LEVEL_NONE
 #endif
 
+/* Keep the bus strongly driven high during conversion for parasite powered
+ * sensors, unless conversion completion is polled (requires external power).
+ */
+#if CONFIG_OW_DS_CONVERSION_POLLING
+#define CONVERT_POWER 0
+#else
+#define CONVERT_POWER 1
+#endif
+
+/* DS18B20 configuration register: R1 R0 bits, low bits read as 1 */
+#define DS_CONFIG_RESOLUTION(_bits) ((uint8_t)((((_bits)-9U) << 5U) | 0x1FU))
+
+/* Maximum conversion time for 9, 10, 11 and 12 bits (datasheet) */
+static const uint16_t conversion_time_ms[] = {94U, 188U, 375U, 750U};
+
 struct ow_dev {
     OneWire ow;
 };
@@ -33,6 +49,10 @@ static struct ow_dev dev = {.ow = OneWire()};
 void ow_ds_drv_init(uint8_t pin)
 {
     dev.ow.begin(pin);
+
+#if CONFIG_OW_ASYNC
+    ow_async_init(pin);
+#endif
 }
 
 static inline int8_t handle_addr(uint8_t *addr, uint8_t *type)
@@ -129,31 +149,27 @@ int8_t ow_ds_drv_read_start(ow_ds_id_t *id)
     }
 
     dev.ow.select(id->addr);
-    dev.ow.write(0x44, 1); // start conversion, with parasite power on at the end
+    dev.ow.write(0x44, CONVERT_POWER); // start conversion
 
     return OW_DS_DRV_SUCCESS;
 }
 
-int8_t ow_ds_drv_read_handle_result(ow_ds_id_t *id, int16_t *temperature)
+int8_t ow_ds_drv_convert_all(void)
 {
-    if (!id || !temperature) {
-        return -OW_DS_DRV_INVALID_PARAMS;
-    }
-
-    // we might do a ds.depower() here, but the reset will take care of it.
-
     if (dev.ow.reset() != 1U) {
         return -OW_DS_DRV_NO_DEVICES;
     }
 
-    dev.ow.select(id->addr);
-    dev.ow.write(0xBE); // Read Scratchpad
+    dev.ow.skip();                     // address all devices
+    dev.ow.write(0x44, CONVERT_POWER); // start conversion
 
-    // we need 9 bytes
-    uint8_t data[9];
+    return OW_DS_DRV_SUCCESS;
+}
+
+static int8_t decode_scratchpad(ow_ds_id_t *id, const uint8_t data[9], int16_t *temperature)
+{
     byte any = 0x00U;
     for (int i = 0; i < 9; i++) {
-        data[i] = dev.ow.read();
         any |= data[i];
     }
 
@@ -192,14 +208,207 @@ int8_t ow_ds_drv_read_handle_result(ow_ds_id_t *id, int16_t *temperature)
         LOG_DBG("res: %hhx", res);
     }
 
-    /* TODO handle the case were the resolution is not 12 bits, in which case
-     * we need to write the scratchpad */
-
     *temperature = raw_to_T16(tmp);
 
     return OW_DS_DRV_SUCCESS;
 }
 
+int8_t ow_ds_drv_read_handle_result(ow_ds_id_t *id, int16_t *temperature)
+{
+    if (!id || !temperature) {
+        return -OW_DS_DRV_INVALID_PARAMS;
+    }
+
+    // we might do a ds.depower() here, but the reset will take care of it.
+
+    if (dev.ow.reset() != 1U) {
+        return -OW_DS_DRV_NO_DEVICES;
+    }
+
+    dev.ow.select(id->addr);
+    dev.ow.write(0xBE); // Read Scratchpad
+
+    // we need 9 bytes
+    uint8_t data[9];
+    dev.ow.read_bytes(data, 9U);
+
+    return decode_scratchpad(id, data, temperature);
+}
+
+#if CONFIG_OW_ASYNC
+
+static struct {
+    /* MATCH ROM + address + command */
+    uint8_t tx[10];
+    uint8_t rx[9];
+    ow_ds_drv_cb_t cb;
+} async;
+
+static void async_done(int8_t status, void *user_data)
+{
+    async.cb((status == 0) ? OW_DS_DRV_SUCCESS : -OW_DS_DRV_NO_DEVICES, user_data);
+}
+
+static int8_t async_submit(uint8_t tx_len,
+                           uint8_t rx_len,
+                           uint8_t power,
+                           ow_ds_drv_cb_t cb,
+                           void *user_data)
+{
+    struct ow_async_xfer xfer;
+
+    xfer.tx     = async.tx;
+    xfer.rx     = async.rx;
+    xfer.tx_len = tx_len;
+    xfer.rx_len = rx_len;
+    xfer.reset  = 1U;
+    xfer.power  = power;
+
+    async.cb = cb;
+
+    return (ow_async_submit(&xfer, async_done, user_data) == 0)
+               ? OW_DS_DRV_SUCCESS
+               : -OW_DS_DRV_SENS_OS_ERROR;
+}
+
+int8_t ow_ds_drv_convert_all_async(ow_ds_drv_cb_t cb, void *user_data)
+{
+    if (!cb || ow_async_busy()) {
+        return -OW_DS_DRV_INVALID_PARAMS;
+    }
+
+    async.tx[0] = 0xCC; // Skip ROM
+    async.tx[1] = 0x44; // Convert T
+
+    return async_submit(2U, 0U, CONVERT_POWER, cb, user_data);
+}
+
+int8_t ow_ds_drv_read_async(ow_ds_id_t *id, ow_ds_drv_cb_t cb, void *user_data)
+{
+    if (!id || !cb || ow_async_busy()) {
+        return -OW_DS_DRV_INVALID_PARAMS;
+    }
+
+    async.tx[0] = 0x55; // Match ROM
+    memcpy(&async.tx[1], id->addr, 8U);
+    async.tx[9] = 0xBE; // Read Scratchpad
+
+    return async_submit(10U, sizeof(async.rx), 0U, cb, user_data);
+}
+
+int8_t ow_ds_drv_read_async_result(ow_ds_id_t *id, int16_t *temperature)
+{
+    if (!id || !temperature) {
+        return -OW_DS_DRV_INVALID_PARAMS;
+    }
+
+    return decode_scratchpad(id, async.rx, temperature);
+}
+
+#endif /* CONFIG_OW_ASYNC */
+
+static int8_t read_scratchpad(ow_ds_id_t *id, uint8_t data[9])
+{
+    if (dev.ow.reset() != 1U) {
+        return -OW_DS_DRV_NO_DEVICES;
+    }
+
+    dev.ow.select(id->addr);
+    dev.ow.write(0xBE); // Read Scratchpad
+    dev.ow.read_bytes(data, 9U);
+
+    if (OneWire::crc8(data, 8) != data[8]) {
+        return -OW_DS_DRV_CRC_ERROR;
+    }
+
+    return OW_DS_DRV_SUCCESS;
+}
+
+int8_t ow_ds_drv_verify(ow_ds_id_t *id)
+{
+    int8_t ret;
+    uint8_t data[9];
+
+    if (!id) {
+        return -OW_DS_DRV_INVALID_PARAMS;
+    }
+
+    ret = read_scratchpad(id, data);
+    if (ret == OW_DS_DRV_SUCCESS) {
+        uint8_t any = 0x00U;
+        for (uint8_t i = 0U; i < 9U; i++) {
+            any |= data[i];
+        }
+
+        /* nobody answered the MATCH ROM if all bytes are null */
+        if (any == 0x00U) {
+            ret = -OW_DS_DRV_NULL_DATA;
+        }
+    }
+
+    return ret;
+}
+
+int8_t ow_ds_drv_set_resolution(ow_ds_id_t *id, uint8_t resolution)
+{
+    int8_t ret;
+    uint8_t data[9];
+
+    if (!id || (resolution < OW_DS_RESOLUTION_MIN) ||
+        (resolution > OW_DS_RESOLUTION_MAX)) {
+        return -OW_DS_DRV_INVALID_PARAMS;
+    }
+
+    /* DS18S20 resolution is fixed */
+    if (id->type) {
+        return OW_DS_DRV_SUCCESS;
+    }
+
+    ret = read_scratchpad(id, data);
+    if (ret != OW_DS_DRV_SUCCESS) {
+        return ret;
+    }
+
+    const uint8_t config = DS_CONFIG_RESOLUTION(resolution);
+    if (data[4] == config) {
+        return OW_DS_DRV_SUCCESS;
+    }
+
+    /* Write Scratchpad: TH, TL (alarm registers kept) and configuration */
+    dev.ow.reset();
+    dev.ow.select(id->addr);
+    dev.ow.write(0x4E);
+    dev.ow.write(data[2]);
+    dev.ow.write(data[3]);
+    dev.ow.write(config);
+
+    /* Copy Scratchpad to EEPROM, with parasite power on at the end */
+    dev.ow.reset();
+    dev.ow.select(id->addr);
+    dev.ow.write(0x48, 1);
+    k_sleep(K_MSEC(10)); // EEPROM write time
+    dev.ow.depower();
+
+    LOG_DBG("res set to %hhu bits", resolution);
+
+    return OW_DS_DRV_SUCCESS;
+}
+
+uint16_t ow_ds_drv_conversion_time_ms(const ow_ds_id_t *id, uint8_t resolution)
+{
+    if (id->type || (resolution < OW_DS_RESOLUTION_MIN) ||
+        (resolution > OW_DS_RESOLUTION_MAX)) {
+        return conversion_time_ms[OW_DS_RESOLUTION_MAX - OW_DS_RESOLUTION_MIN];
+    }
+
+    return conversion_time_ms[resolution - OW_DS_RESOLUTION_MIN];
+}
+
+bool ow_ds_drv_conversion_done(void)
+{
+    return dev.ow.read_bit() != 0U;
+}
+
 int8_t ow_ds_drv_read(ow_ds_id_t *id, int16_t *temperature)
 {
     int8_t ret;
@@ -16,11 +16,17 @@
 #ifndef _OW_DS_DRV_H_
 #define _OW_DS_DRV_H_
 
+#include "config.h"
+
 #include <stdbool.h>
 #include <stdint.h>
 
 #define OW_DS_MEAS_DURATION_MS 1000U
 
+/* Supported DS18B20 resolutions (bits) */
+#define OW_DS_RESOLUTION_MIN 9U
+#define OW_DS_RESOLUTION_MAX 12U
+
 /* PB1 */
 #if !defined(CONFIG_OW_DS_ARDUINO_PIN)
 #define CONFIG_OW_DS_ARDUINO_PIN 9U
@@ -79,6 +85,15 @@ int8_t ow_ds_drv_discover_iter(uint8_t max_devices,
  */
 int8_t ow_ds_drv_discover(ow_ds_id_t *array, uint8_t size);
 
+/**
+ * @brief Check that the given DS device answers on the bus (MATCH ROM followed
+ *   by a scratchpad read with a valid CRC), without a full ROM search.
+ *
+ * @param id Device address
+ * @return int8_t 0 if the device answered, negative value on error
+ */
+int8_t ow_ds_drv_verify(ow_ds_id_t *id);
+
 /**
  * @brief Read temperature from the given DS temperature sensor
  *
@@ -97,6 +112,85 @@ int8_t ow_ds_drv_read(ow_ds_id_t *id, int16_t *temperature);
  */
 int8_t ow_ds_drv_read_start(ow_ds_id_t *id);
 
+/**
+ * @brief Start a conversion on all DS temperature sensors of the bus at once
+ *   (SKIP ROM + CONVERT T), results are then fetched for each sensor with
+ *   ow_ds_drv_read_handle_result().
+ *
+ * @return int8_t 0 on success, negative value on error
+ */
+int8_t ow_ds_drv_convert_all(void);
+
+#if CONFIG_OW_ASYNC
+/**
+ * @brief Completion callback of asynchronous operations, called from the ISR
+ *   context
+ *
+ * @param status 0 on success, negative value on error
+ */
+typedef void (*ow_ds_drv_cb_t)(int8_t status, void *user_data);
+
+/**
+ * @brief Non-blocking variant of ow_ds_drv_convert_all()
+ *
+ * @param cb Completion callback
+ * @param user_data
+ * @return int8_t 0 if started, negative value on error
+ */
+int8_t ow_ds_drv_convert_all_async(ow_ds_drv_cb_t cb, void *user_data);
+
+/**
+ * @brief Start reading the scratchpad of the given DS temperature sensor
+ *   without blocking, result is retrieved with ow_ds_drv_read_async_result()
+ *   once the callback is called.
+ *
+ * @param id Device address
+ * @param cb Completion callback
+ * @param user_data
+ * @return int8_t 0 if started, negative value on error
+ */
+int8_t ow_ds_drv_read_async(ow_ds_id_t *id, ow_ds_drv_cb_t cb, void *user_data);
+
+/**
+ * @brief Decode the scratchpad fetched by the last ow_ds_drv_read_async()
+ *
+ * @param id Device address
+ * @param temperature Variable to store the temperature in (in 1e-2 °C)
+ * @return int8_t 0 on success, negative value on error
+ */
+int8_t ow_ds_drv_read_async_result(ow_ds_id_t *id, int16_t *temperature);
+#endif /* CONFIG_OW_ASYNC */
+
+/**
+ * @brief Configure the conversion resolution of the given DS temperature sensor.
+ *   The scratchpad is first read, the configuration is written
+ *   (WRITE SCRATCHPAD + COPY SCRATCHPAD) only if it differs, in order to spare
+ *   the sensor EEPROM. DS18S20 sensors have a fixed resolution and are skipped.
+ *
+ * @param id Device address
+ * @param resolution Resolution in bits (9 to 12)
+ * @return int8_t 0 on success, negative value on error
+ */
+int8_t ow_ds_drv_set_resolution(ow_ds_id_t *id, uint8_t resolution);
+
+/**
+ * @brief Get the maximum conversion time of the given DS temperature sensor
+ *
+ * @param id Device address
+ * @param resolution Resolution in bits (9 to 12)
+ * @return uint16_t Conversion time in milliseconds
+ */
+uint16_t ow_ds_drv_conversion_time_ms(const ow_ds_id_t *id, uint8_t resolution);
+
+/**
+ * @brief Poll the bus for conversion completion (read slot returns 1 once all
+ *   converting sensors are done). Only meaningful for externally powered
+ *   sensors, see CONFIG_OW_DS_CONVERSION_POLLING.
+ *
+ * @return true if no conversion is in progress anymore
+ */
+bool ow_ds_drv_conversion_done(void);
+
 /**
  * @brief Handle read from the given DS temperature sensor (after at least 750ms)
  *
@@ -13,12 +13,48 @@
 #include <avrtos/logging.h>
 
 #include <bsp/bsp.h>
+#include <ee.h>
+#include <utils/crc.h>
 #if defined(CONFIG_OW_LOG_LEVEL)
 #define LOG_LEVEL CONFIG_OW_LOG_LEVEL
 #else
 #define LOG_LEVEL LOG_LEVEL_NONE
 #endif
 
+#if CONFIG_OW_DS_ROM_CACHE
+
+#define OW_ROM_CACHE_SLOTS 3U
+
+/* Sensors found on the bus, so that boot and rediscoveries only need to
+ * verify them instead of running a full ROM search
+ */
+struct eeprom_ow_rom_cache {
+    ow_ds_id_t ids[OW_ROM_CACHE_SLOTS];
+
+    /* Slots holding a valid ROM */
+    uint8_t registered_mask;
+
+    /* Structure size, used as a marker to make sure the structure is valid */
+    uint8_t size;
+
+    /* Checksum of the structure */
+    uint8_t checksum;
+} __packed;
+
+#define EEPROM_OW_ROM_CACHE_SIZE sizeof(struct eeprom_ow_rom_cache)
+
+__STATIC_ASSERT(EEPROM_OW_ROM_CACHE_SIZE <= EEPROM_OW_ROM_CACHE_MAX_SIZE,
+                "EEPROM_OW_ROM_CACHE_SIZE too big");
+
+#endif /* CONFIG_OW_DS_ROM_CACHE */
+
+enum {
+    PHASE_IDLE = 0U, /* next event starts a new cycle */
+    PHASE_CONVERT,   /* conversion command being sent (async) */
+    PHASE_WAIT,      /* waiting for the conversion to complete */
+    PHASE_READ,      /* scratchpad of sensor ctx.cur being read (async) */
+};
+
 struct meas_context {
     /* array of sensors ids */
     ow_ds_sensor_t *sensors;
@@ -35,11 +71,30 @@ struct meas_context {
     /* Flag to indicate that next event should be meas_running */
     uint8_t meas_running : 1;
 
+    /* Broadcast conversion cycle phase */
+    uint8_t phase : 2;
+
+    /* Flag to indicate that sensors were (un)registered since the last
+     * discovery, i.e. the ROM cache must be rewritten
+     */
+    uint8_t rom_changed : 1;
+
     /* time to next discovery */
     uint16_t remaining_to_discovery;
 
+#if CONFIG_OW_DS_CONVERSION_POLLING
+    /* time left before the conversion is considered complete anyway */
+    uint16_t conv_remaining_ms;
+#endif
+
+#if CONFIG_OW_ASYNC
+    /* status of the last asynchronous OneWire transfer */
+    volatile int8_t xfer_status;
+#endif
+
     /* period between two measurements
-     * (between two different sensors
+     * (between two different sensors, or between two
+     * full refreshes in broadcast conversion mode)
      */
     uint32_t period_ms;
 
@@ -96,6 +151,7 @@ static uint8_t get_active_sensors_count(void)
     return count;
 }
 
+#if !CONFIG_OW_DS_BROADCAST_CONVERSION
 static int8_t measure_sensor(ow_ds_sensor_t *sens)
 {
     int8_t ret;
@@ -125,6 +181,7 @@ static int8_t measure_sensor(ow_ds_sensor_t *sens)
 
     return ret;
 }
+#endif
 
 static bool ds_discovered_cb(ow_ds_id_t *id, void *user_data)
 {
@@ -139,6 +196,7 @@ static bool ds_discovered_cb(ow_ds_id_t *id, void *user_data)
             memcpy(&sensor->id, id, sizeof(ow_ds_id_t));
 
             sensor->registered = 1U;
+            ctx.rom_changed    = 1U;
 
             /* Invalidate sensor measurement only on first discovery */
             sensor->valid = 0U;
@@ -160,25 +218,216 @@ static bool ds_discovered_cb(ow_ds_id_t *id, void *user_data)
     return sensor != NULL;
 }
 
+#if CONFIG_OW_DS_ROM_CACHE
+
+static uint8_t get_registered_mask(void)
+{
+    uint8_t mask = 0U;
+
+    for (uint8_t i = 0U; i < ctx.expected; i++) {
+        if (ctx.sensors[i].registered == 1U) {
+            mask |= BIT(i);
+        }
+    }
+
+    return mask;
+}
+
+static void rom_cache_load(void)
+{
+    struct eeprom_ow_rom_cache cache;
+
+    ee_read_block(&cache, EEPROM_OW_ROM_CACHE_OFFSET, EEPROM_OW_ROM_CACHE_SIZE);
+
+    if ((cache.size != EEPROM_OW_ROM_CACHE_SIZE) ||
+        (crc8((const uint8_t *)&cache, EEPROM_OW_ROM_CACHE_SIZE) != 0U)) {
+        LOG_DBG("ow rom cache invalid");
+        return;
+    }
+
+    const uint8_t slots = MIN(ctx.expected, OW_ROM_CACHE_SLOTS);
+    for (uint8_t i = 0U; i < slots; i++) {
+        ow_ds_sensor_t *sens = &ctx.sensors[i];
+
+        /* serial numbers configured at build time take precedence */
+        if ((sens->registered == 0U) && (cache.registered_mask & BIT(i)) &&
+            (get_sensor_by_id(&cache.ids[i]) == NULL)) {
+            memcpy(&sens->id, &cache.ids[i], sizeof(ow_ds_id_t));
+            sens->registered = 1U;
+        }
+    }
+}
+
+static void rom_cache_save(void)
+{
+    struct eeprom_ow_rom_cache cache;
+
+    memset(&cache, 0x00U, sizeof(cache));
+
+    const uint8_t slots = MIN(ctx.expected, OW_ROM_CACHE_SLOTS);
+    for (uint8_t i = 0U; i < slots; i++) {
+        memcpy(&cache.ids[i], &ctx.sensors[i].id, sizeof(ow_ds_id_t));
+    }
+
+    cache.registered_mask = get_registered_mask() & (BIT(OW_ROM_CACHE_SLOTS) - 1U);
+    cache.size            = EEPROM_OW_ROM_CACHE_SIZE;
+    cache.checksum = crc8((const uint8_t *)&cache, EEPROM_OW_ROM_CACHE_SIZE - 1U);
+
+    /* only the modified bytes are actually written */
+    ee_update_block(&cache, EEPROM_OW_ROM_CACHE_OFFSET, EEPROM_OW_ROM_CACHE_SIZE);
+
+    LOG_DBG("ow rom cache saved");
+}
+
+#endif /* CONFIG_OW_DS_ROM_CACHE */
+
+/* Check the known sensors which are missing with a MATCH ROM instead of a full
+ * ROM search, return the number of sensors still not found.
+ *
+ * A sensor which fails OW_DS_MAX_FAILED_VERIFIES verifications in a row
+ * (e.g. removed or replaced) is unregistered to free its slot for the full
+ * search, unless its ROM is configured at build time.
+ */
+static uint8_t verify_missing(void)
+{
+    uint8_t missing = 0U;
+    ow_ds_sensor_t *sens;
+
+    for (sens = ctx.sensors; sens < ctx.sensors + ctx.expected; sens++) {
+        if (sens->active == 1U) {
+            continue;
+        }
+
+        if (sens->registered == 1U) {
+            if (ow_ds_drv_verify(&sens->id) == 0) {
+                LOG_DBG("ow sens: %p verified", (void *)sens);
+                sens->errors      = 0U;
+                sens->active      = 1U;
+                sens->in_progress = 0U;
+                continue;
+            }
+
+            /* errors counts the failed verifications while inactive */
+            sens->errors++;
+            if (!sens->pinned && (sens->errors >= OW_DS_MAX_FAILED_VERIFIES)) {
+                LOG_WRN("ow sens: %p unregistered", (void *)sens);
+                sens->registered = 0U;
+                sens->valid      = 0U;
+                sens->errors     = 0U;
+                ctx.rom_changed  = 1U;
+            }
+        }
+
+        missing++;
+    }
+
+    return missing;
+}
+
 static int8_t discover()
 {
-    int8_t ret = ow_ds_drv_discover_iter(ctx.expected, ds_discovered_cb, NULL);
+    int8_t ret;
 
-    LOG_DBG("discovered %d OW sensors", ret);
+    /* a full search can only help if some slots are still free, including
+     * the slots of the sensors unregistered by verify_missing()
+     */
+    if ((verify_missing() != 0U) && (get_free_slot() != NULL)) {
+        ret = ow_ds_drv_discover_iter(ctx.expected, ds_discovered_cb, NULL);
+        LOG_DBG("discovered %d OW sensors", ret);
+    } else {
+        ret = get_active_sensors_count();
+    }
 
     /* at least one sensor should be discovered */
     ctx.do_discovery = ret <= 0u;
 
+    /* apply configured resolution to the sensors found */
+    for (ow_ds_sensor_t *sens = ctx.sensors; sens < ctx.sensors + ctx.expected;
+         sens++) {
+        if (sens->active &&
+            (ow_ds_drv_set_resolution(
+                 &sens->id, OW_DS_RESOLUTION_DECODE(sens->resolution)) != 0)) {
+            LOG_WRN("ow sens: %p res not set", (void *)sens);
+        }
+    }
+
+#if CONFIG_OW_DS_ROM_CACHE
+    if (ctx.rom_changed) {
+        rom_cache_save();
+    }
+#endif
+    ctx.rom_changed = 0U;
+
     ctx.remaining_to_discovery = OW_DS_DISCOVERIES_PERIODICITY * ctx.expected;
 
     return ret;
 }
 
-static void meas_handler(struct k_work *w)
+static uint16_t conversion_time_ms(ow_ds_sensor_t *sens)
 {
-    int8_t ret;
+    return ow_ds_drv_conversion_time_ms(&sens->id,
+                                        OW_DS_RESOLUTION_DECODE(sens->resolution));
+}
+
+static void conversion_wait(uint16_t ms)
+{
+#if CONFIG_OW_DS_CONVERSION_POLLING
+    /* wake up periodically to poll the bus for completion */
+    ctx.conv_remaining_ms = ms;
+    ms                    = MIN(ms, CONFIG_OW_DS_POLL_INTERVAL_MS);
+    ctx.conv_remaining_ms -= ms;
+#endif
+
+    k_event_schedule(&ctx._ev, K_MSEC(ms));
+}
+
+/* Return true if the conversion is still running and a new wait is scheduled */
+static bool conversion_pending(void)
+{
+#if CONFIG_OW_DS_CONVERSION_POLLING
+    if ((ctx.conv_remaining_ms != 0U) && !ow_ds_drv_conversion_done()) {
+        conversion_wait(ctx.conv_remaining_ms);
+        return true;
+    }
+#endif
+
+    return false;
+}
+
+static void handle_result(ow_ds_sensor_t *sens, int8_t ret)
+{
+    if (ret == OW_DS_DRV_SUCCESS) {
+        /* if the sensor has been discovered, try to read it's temperature
+         */
+        LOG_INF("ow sens: %p temp: %d.%02u °C",
+                (void *)sens,
+                sens->temp / 100,
+                sens->temp % 100u);
+
+        sens->valid  = 1U;
+        sens->errors = 0U;
+    } else {
+        LOG_WRN("ow sens: %p failed", (void *)sens);
 
-    const uint8_t diff = ctx.expected - get_active_sensors_count();
+        sens->valid = 0U;
+        sens->errors++;
+
+        if ((ret == -OW_DS_DRV_SENS_MEAS_FAILED) &&
+            (sens->errors > OW_DS_MAX_CONSECUTIVE_ERRORS)) {
+
+            /* if too many consecutive errors, deactivate the sensor
+             * and trigger a new discovery
+             */
+            sens->active     = 0U;
+            sens->errors     = 0U;
+            ctx.do_discovery = 1U;
+        }
+    }
+}
+
+static void discover_if_needed(uint8_t steps)
+{
+    const uint8_t diff = (ctx.expected - get_active_sensors_count()) * steps;
     if (ctx.remaining_to_discovery < diff) {
         ctx.do_discovery = 1U;
     } else {
@@ -189,6 +438,179 @@ static void meas_handler(struct k_work *w)
     if (ctx.do_discovery == 1U) {
         discover();
     }
+}
+
+#if CONFIG_OW_DS_BROADCAST_CONVERSION
+
+/* slowest active sensor sets the shared conversion wait */
+static uint16_t max_conversion_time_ms(void)
+{
+    uint16_t ms = 0U;
+    ow_ds_sensor_t *sens;
+
+    for (sens = ctx.sensors; sens < ctx.sensors + ctx.expected; sens++) {
+        if (sens->active) {
+            ms = MAX(ms, conversion_time_ms(sens));
+        }
+    }
+
+    return ms;
+}
+
+/* A failed broadcast conversion is a measurement failure of every active
+ * sensor, whatever the bus error was.
+ */
+static void fail_active_sensors(int8_t ret)
+{
+    ow_ds_sensor_t *sens;
+
+    LOG_WRN("ow conversion failed: %d", ret);
+
+    for (sens = ctx.sensors; sens < ctx.sensors + ctx.expected; sens++) {
+        if (sens->active) {
+            handle_result(sens, -OW_DS_DRV_SENS_MEAS_FAILED);
+        }
+    }
+}
+
+#if CONFIG_OW_ASYNC
+/* OneWire transfer completed (ISR context) */
+static void xfer_done(int8_t status, void *user_data)
+{
+    ctx.xfer_status = status;
+    k_system_workqueue_submit(&ctx._work);
+}
+
+/* Start reading the next active sensor from ctx.cur,
+ * return true if a transfer is in progress
+ */
+static bool read_next(void)
+{
+    for (; ctx.cur < ctx.expected; ctx.cur++) {
+        ow_ds_sensor_t *sens = &ctx.sensors[ctx.cur];
+
+        if (sens->active) {
+            const int8_t ret = ow_ds_drv_read_async(&sens->id, xfer_done, NULL);
+            if (ret == OW_DS_DRV_SUCCESS) {
+                return true;
+            }
+
+            handle_result(sens, ret);
+        }
+    }
+
+    return false;
+}
+#endif
+
+static void meas_handler(struct k_work *w)
+{
+    int8_t ret;
+
+    switch (ctx.phase) {
+    case PHASE_IDLE:
+        /* a cycle accounts for one measurement of each sensor */
+        discover_if_needed(ctx.expected);
+
+        if (get_active_sensors_count() != 0U) {
+#if CONFIG_OW_ASYNC
+            ret = ow_ds_drv_convert_all_async(xfer_done, NULL);
+            if (ret == OW_DS_DRV_SUCCESS) {
+                ctx.phase = PHASE_CONVERT;
+                return;
+            }
+#else
+            ret = ow_ds_drv_convert_all();
+            if (ret == OW_DS_DRV_SUCCESS) {
+                ctx.phase = PHASE_WAIT;
+                conversion_wait(max_conversion_time_ms());
+                return;
+            }
+#endif
+
+            fail_active_sensors(ret);
+        }
+        break;
+
+#if CONFIG_OW_ASYNC
+    case PHASE_CONVERT:
+        if (ctx.xfer_status == OW_DS_DRV_SUCCESS) {
+            ctx.phase = PHASE_WAIT;
+            conversion_wait(max_conversion_time_ms());
+            return;
+        }
+
+        ctx.phase = PHASE_IDLE;
+        fail_active_sensors(ctx.xfer_status);
+        break;
+#endif
+
+    case PHASE_WAIT:
+        if (conversion_pending()) {
+            return;
+        }
+
+        /* all sensors converted during the same wait, fetch them in a row */
+#if CONFIG_OW_ASYNC
+        ctx.cur = 0U;
+        if (read_next()) {
+            ctx.phase = PHASE_READ;
+            return;
+        }
+#else
+        for (ow_ds_sensor_t *sens = ctx.sensors; sens < ctx.sensors + ctx.expected;
+             sens++) {
+            if (sens->active) {
+                ret = ow_ds_drv_read_handle_result(&sens->id, &sens->temp);
+                handle_result(sens, ret);
+            }
+        }
+#endif
+
+        ctx.phase = PHASE_IDLE;
+        break;
+
+#if CONFIG_OW_ASYNC
+    case PHASE_READ:
+    {
+        ow_ds_sensor_t *sens = &ctx.sensors[ctx.cur];
+
+        ret = ctx.xfer_status;
+        if (ret == OW_DS_DRV_SUCCESS) {
+            ret = ow_ds_drv_read_async_result(&sens->id, &sens->temp);
+        }
+        handle_result(sens, ret);
+
+        ctx.cur++;
+        if (read_next()) {
+            return;
+        }
+
+        ctx.phase = PHASE_IDLE;
+        break;
+    }
+#endif
+
+    default:
+        ctx.phase = PHASE_IDLE;
+        break;
+    }
+
+    /* check if we continue the periodic measurements or not */
+    if (ctx.meas_running == 1U) {
+        k_event_schedule(&ctx._ev, K_MSEC(ctx.period_ms));
+    } else {
+        k_sem_give(&ctx._sched_sem);
+    }
+}
+
+#else
+
+static void meas_handler(struct k_work *w)
+{
+    int8_t ret;
+
+    discover_if_needed(1U);
 
     ow_ds_sensor_t *sens = &ctx.sensors[ctx.cur];
 
@@ -197,41 +619,19 @@ static void meas_handler(struct k_work *w)
             ret = ow_ds_drv_read_start(&sens->id);
             if (ret == OW_DS_DRV_SUCCESS) {
                 sens->in_progress = 1U;
-                k_event_schedule(&ctx._ev, K_MSEC(OW_DS_MEAS_DURATION_MS));
+                conversion_wait(conversion_time_ms(sens));
                 return;
             }
         } else {
+            if (conversion_pending()) {
+                return;
+            }
+
             ret               = ow_ds_drv_read_handle_result(&sens->id, &sens->temp);
             sens->in_progress = 0U;
         }
 
-        if (ret == OW_DS_DRV_SUCCESS) {
-            /* if the sensor has been discovered, try to read it's temperature
-             */
-            LOG_INF("ow sens: %p temp: %d.%02u °C",
-                    (void *)sens,
-                    sens->temp / 100,
-                    sens->temp % 100u);
-
-            sens->valid  = 1U;
-            sens->errors = 0U;
-        } else {
-            LOG_WRN("ow sens: %p failed", (void *)sens);
-
-            sens->valid = 0U;
-            sens->errors++;
-
-            if ((ret == -OW_DS_DRV_SENS_MEAS_FAILED) &&
-                (sens->errors > OW_DS_MAX_CONSECUTIVE_ERRORS)) {
-
-                /* if too many consecutive errors, deactivate the sensor
-                 * and trigger a new discovery
-                 */
-                sens->active     = 0U;
-                sens->errors     = 0U;
-                ctx.do_discovery = 1U;
-            }
-        }
+        handle_result(sens, ret);
     }
 
     /* fetch next sensor */
@@ -245,6 +645,8 @@ static void meas_handler(struct k_work *w)
     }
 }
 
+#endif /* CONFIG_OW_DS_BROADCAST_CONVERSION */
+
 int8_t ds_init(ow_ds_sensor_t *array, uint8_t count)
 {
     int8_t ret = -EINVAL;
@@ -257,11 +659,17 @@ int8_t ds_init(ow_ds_sensor_t *array, uint8_t count)
         ctx.cur          = 0U;
         ctx.do_discovery = 1U;
         ctx.meas_running = 0U;
+        ctx.phase        = PHASE_IDLE;
+        ctx.rom_changed  = 0U;
 
         k_work_init(&ctx._work, meas_handler);
         k_event_init(&ctx._ev, event_handler);
         k_sem_init(&ctx._sched_sem, 1U, 1U);
 
+#if CONFIG_OW_DS_ROM_CACHE
+        rom_cache_load();
+#endif
+
         ret = 0;
     }
 
@@ -317,17 +725,40 @@ int8_t ds_measure_all(void)
     int8_t ret = -OW_DS_DRV_PERIODIC_MEAS_STARTED;
 
     if (ds_meas_running() == false) {
-        uint8_t ret = OW_DS_DRV_SUCCESS;
+        ret = OW_DS_DRV_SUCCESS;
+
+#if CONFIG_OW_DS_BROADCAST_CONVERSION
+        /* single conversion wait shared by all sensors */
+        const int8_t conv = ow_ds_drv_convert_all();
+        if (conv == OW_DS_DRV_SUCCESS) {
+            k_sleep(K_MSEC(max_conversion_time_ms()));
+        } else {
+            /* accounted as a conversion failure of every active sensor */
+            fail_active_sensors(conv);
+        }
+#endif
 
         /* iterate over all sensors and read their temperature */
         for (uint8_t i = 0; i < ctx.expected; i++) {
             ow_ds_sensor_t *sens = &ctx.sensors[i];
 
+#if CONFIG_OW_DS_BROADCAST_CONVERSION
+            if ((conv != OW_DS_DRV_SUCCESS) || !sens->active) {
+                continue;
+            }
+
+            const int8_t err = ow_ds_drv_read_handle_result(&sens->id, &sens->temp);
+            handle_result(sens, err);
+            if (err == OW_DS_DRV_SUCCESS) {
+                ret++;
+            }
+#else
             if (measure_sensor(sens) == OW_DS_DRV_SUCCESS) {
                 ret++;
             }
+#endif
         }
     }
 
     return ret;
-}
\ No newline at end of file
+}
@@ -17,6 +17,10 @@
 // Max errors before trying to discover again
 #define OW_DS_MAX_CONSECUTIVE_ERRORS 4U
 
+// Consecutive failed verifications (MATCH ROM) before a missing sensor is
+// unregistered, so that its slot can be taken by another sensor
+#define OW_DS_MAX_FAILED_VERIFIES 3U
+
 // Number of measurements for each sensor before triggering a discovery
 // default 10U
 #define OW_DS_DISCOVERIES_PERIODICITY 5U
@@ -61,8 +65,22 @@ typedef struct {
      * @brief Indicates if a measurement is in progress for the current sensor
      */
     uint8_t in_progress : 1;
+
+    /**
+     * @brief Conversion resolution, in bits above OW_DS_RESOLUTION_MIN
+     */
+    uint8_t resolution : 2;
+
+    /**
+     * @brief Indicates if sensor id is configured at build time,
+     *   such a sensor is never unregistered
+     */
+    uint8_t pinned : 1;
 } ow_ds_sensor_t;
 
+#define OW_DS_RESOLUTION_ENCODE(_bits) (((_bits)-OW_DS_RESOLUTION_MIN) & 0x3U)
+#define OW_DS_RESOLUTION_DECODE(_res)  ((_res) + OW_DS_RESOLUTION_MIN)
+
 /**
  * @brief Initialize the context, reference sensors array
  *
@@ -23,14 +23,13 @@ void pcf8574_init(struct pcf8574_state *pcf, uint8_t i2c_addr)
     pcf->read_buffer_valid = 0u;
 #endif
 #if CONFIG_PCF8574_BUFFERED_WRITE
-    pcf->write_buffer = 0u;
+    /* All pins are high (inputs) at power-on */
+    pcf->write_buffer = 0xFFu;
 #endif
 }
 
 void pcf8574_set(struct pcf8574_state *pcf, uint8_t value)
 {
-    size_t w;
-
 #if CONFIG_PCF8574_BUFFERED_WRITE
     if (pcf->write_buffer == value) return;
 #endif
@@ -41,9 +40,7 @@ void pcf8574_set(struct pcf8574_state *pcf, uint8_t value)
     LOG_DBG("PCF8574 I2C w x%02x ok: %d", value, res);
 
 #if CONFIG_PCF8574_BUFFERED_WRITE
-    if (w != 0) pcf->write_buffer = value;
-#else
-    (void)w;
+    if (res == 0) pcf->write_buffer = value;
 #endif
 }
 
@@ -132,6 +132,7 @@ static void run_direction(uint8_t s, uint8_t dir)
 
     set_active(pos, pos_active);
     set_active(neg, neg_active);
+    bsp_gpio_commit();
 }
 
 static void shutter_event_handler(struct k_event *ev)
@@ -9,51 +9,101 @@
 #include "tcn75.h"
 #include "temp.h"
 
+#include <avrtos/avrtos.h>
+
 #include <caniot/datatype.h>
 
 // 0x28 0xd4 0x39 0xb8 0x32 0x20 0x01 0xf2
 // 0x28 0x2a 0x06 0x41 0x33 0x20 0x01 0x31
 // 0x28 0x3d 0x72 0xbf 0x32 0x20 0x01 0x52
 
-#define OW_DS_SN_NONE()                                                                  \
+#define OW_DS_SN_NONE(res)                                                               \
     {                                                                                    \
-        .registered = 0U,                                                                \
+        .registered = 0U, .resolution = OW_DS_RESOLUTION_ENCODE(res),                    \
     }
 
-#define OW_DS_SN_REGISTER(sn_array)                                                      \
+#define OW_DS_SN_REGISTER(sn_array, res)                                                 \
     {                                                                                    \
         .id =                                                                            \
             {                                                                            \
                 .addr = {sn_array},                                                      \
             },                                                                           \
-        .registered = 1U,                                                                \
+        .registered = 1U, .resolution = OW_DS_RESOLUTION_ENCODE(res), .pinned = 1U,      \
     }
 
 #if CONFIG_OW_DS_ENABLED
 /* use serial numbers to order sensors */
 ow_ds_sensor_t sensors[CONFIG_OW_DS_COUNT] = {
 #if defined(CONFIG_OW_DS_SN_1) && (CONFIG_OW_DS_COUNT >= 1)
-    OW_DS_SN_REGISTER(CONFIG_OW_DS_SN_1),
+    OW_DS_SN_REGISTER(CONFIG_OW_DS_SN_1, CONFIG_OW_DS_RESOLUTION_1),
 #elif (CONFIG_OW_DS_COUNT >= 1)
-    OW_DS_SN_NONE(),
+    OW_DS_SN_NONE(CONFIG_OW_DS_RESOLUTION_1),
 #endif
 
 #if defined(CONFIG_OW_DS_SN_2) && (CONFIG_OW_DS_COUNT >= 2)
-    OW_DS_SN_REGISTER(CONFIG_OW_DS_SN_2),
+    OW_DS_SN_REGISTER(CONFIG_OW_DS_SN_2, CONFIG_OW_DS_RESOLUTION_2),
 #elif (CONFIG_OW_DS_COUNT >= 2)
-    OW_DS_SN_NONE(),
+    OW_DS_SN_NONE(CONFIG_OW_DS_RESOLUTION_2),
 #endif
 
 #if defined(CONFIG_OW_DS_SN_3) && (CONFIG_OW_DS_COUNT >= 3)
-    OW_DS_SN_REGISTER(CONFIG_OW_DS_SN_3),
+    OW_DS_SN_REGISTER(CONFIG_OW_DS_SN_3, CONFIG_OW_DS_RESOLUTION_3),
 #elif (CONFIG_OW_DS_COUNT >= 3)
-    OW_DS_SN_NONE(),
+    OW_DS_SN_NONE(CONFIG_OW_DS_RESOLUTION_3),
+#endif
+};
 #endif
+
+#if CONFIG_TCN75
+/* Last TCN75 reading, refreshed in the background by the system workqueue
+ * so that telemetry handlers never wait on the I2C bus.
+ */
+static struct {
+    int16_t temp;
+    uint32_t timestamp_ms;
+    struct k_work _work;
+    struct k_event _ev;
+} tcn75_cache = {
+    .temp = CANIOT_DT_T16_INVALID,
 };
+
+static void tcn75_sample(void)
+{
+    const int16_t temp = tcn75_read();
+
+    /* as threads are cooperative, no lock is required */
+    if (temp != INT16_MAX) {
+        tcn75_cache.temp         = temp;
+        tcn75_cache.timestamp_ms = k_uptime_get_ms32();
+    } else {
+        tcn75_cache.temp = CANIOT_DT_T16_INVALID;
+    }
+}
+
+/* The I2C read stays blocking, it holds the system workqueue for ~0.3 ms */
+static void tcn75_work_handler(struct k_work *w)
+{
+    tcn75_sample();
+    k_event_schedule(&tcn75_cache._ev, K_MSEC(CONFIG_TCN75_SAMPLE_PERIOD_MS));
+}
+
+static void tcn75_event_handler(struct k_event *ev)
+{
+    k_system_workqueue_submit(&tcn75_cache._work);
+}
 #endif
 
 void temp_start(void)
 {
+#if CONFIG_TCN75
+    k_work_init(&tcn75_cache._work, tcn75_work_handler);
+    k_event_init(&tcn75_cache._ev, tcn75_event_handler);
+
+    /* first sample synchronously so the cache is valid from the start */
+    tcn75_sample();
+    k_event_schedule(&tcn75_cache._ev, K_MSEC(CONFIG_TCN75_SAMPLE_PERIOD_MS));
+#endif
+
 #if CONFIG_OW_DS_ENABLED
     ds_init(sensors, ARRAY_SIZE(sensors));
 
@@ -69,11 +119,11 @@ int16_t temp_read(temp_sens_t sensor)
 
     if (sensor == TEMP_SENS_INT) {
 #if CONFIG_TCN75
-        /**
-         * @brief TCN75 is in continuous measurement mode, so
-         * reading the temperature is "instantaneous".
-         */
-        temp = tcn75_read();
+        /* Only serve the cached value, drop it if sampling stalled */
+        if ((k_uptime_get_ms32() - tcn75_cache.timestamp_ms) <=
+            CONFIG_TCN75_MAX_AGE_MS) {
+            temp = tcn75_cache.temp;
+        }
 #endif
     } else if (CONFIG_OW_DS_ENABLED) {
 #if CONFIG_OW_DS_ENABLED
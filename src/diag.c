@@ -6,34 +6,25 @@
 
 // Don't ever use this code, it is fucked up
 //
-// Todo optimize this code to read only the location in eeprom instead of the whole
-// "diag_reset_context", a buffer is allocated on RAM to store the reset context.
+// The reset stats are read and validated once at init, queries are then served
+// from a RAM mirror which is written back to EEPROM when modified.
 
 #include "config.h"
 #include "diag.h"
+#include "ee.h"
 #include "platform.h"
 #include "utils/crc.h"
 
 #include <avrtos/avrtos.h>
 #include <avrtos/logging.h>
 
-#include <avr/eeprom.h>
-
 #if CONFIG_DIAG
 
 #define K_MODULE K_MODULE_APPLICATION
 #define LOG_LEVEL CONFIG_DIAG_LOG_LEVEL
 
-#define EEPROM_RESET_STATS_MAX_SIZE 64u
-#define EEPROM_RESET_STATS_OFFSET   256u
-
 #define RAM_RESET_CONTEXT_MAGIC 0x444BE182lu
 
-#if EEPROM_RESET_STATS_MAX_SIZE > 64u
-#warning                                                                                 \
-    "Increasing this value have impact on stack usage with CONFIG_DIAG_RESET_CONTEXT_STATIC_RAMBUFFER disabled"
-#endif
-
 #if CONFIG_DIAG_RESET_CONTEXT_PERSISTENT && !CONFIG_DIAG_RESET_REASON
 #error "CONFIG_DIAG_RESET_CONTEXT_PERSISTENT requires CONFIG_DIAG_RESET_REASON"
 #endif
@@ -46,21 +37,6 @@
 #error "CONFIG_DIAG_RESET_REASON requires CONFIG_KERNEL_MINICORE_SAVE_RESET_CAUSE"
 #endif
 
-#if CONFIG_DIAG_RESET_CONTEXT_STATIC_RAMBUFFER
-/* Mutex to protect access to the diag_rambuf */
-static K_MUTEX_DEFINE(diag_mutex);
-static struct eeprom_reset_stats diag_rambuf;
-#define DIAG_LOCK()   k_mutex_lock(&diag_mutex, K_FOREVER)
-#define DIAG_UNLOCK() k_mutex_unlock(&diag_mutex)
-#define DIAG_DECLARE_RAMBUF()
-#define DIAG_GET_RAMBUF_PTR() &diag_rambuf
-#else
-#define DIAG_LOCK()
-#define DIAG_UNLOCK()
-#define DIAG_DECLARE_RAMBUF() struct eeprom_reset_stats z_reset_stats
-#define DIAG_GET_RAMBUF_PTR() &z_reset_stats
-#endif
-
 #if CONFIG_DIAG_RESET_CONTEXT_RUNTIME
 struct accross_reset_context {
     uint32_t magic;
@@ -133,51 +109,55 @@ struct eeprom_reset_stats {
 __STATIC_ASSERT(EEPROM_RESET_STATS_SIZE <= EEPROM_RESET_STATS_MAX_SIZE,
                 "EEPROM_RESET_STATS_SIZE too big");
 
-// Read the reset reset_stats from EEPROM and store them in the reset_stats struct.
-static bool read_reset_stats(struct eeprom_reset_stats *reset_stats)
+/* RAM mirror of the reset stats, valid once diag_init() has been called */
+static struct eeprom_reset_stats reset_stats;
+
+/* The mirror differs from the EEPROM content */
+static bool reset_stats_dirty = false;
+
+// Read the reset stats from EEPROM into the RAM mirror, return whether they are valid.
+static bool read_reset_stats(void)
 {
-    eeprom_read_block(
-        reset_stats, (void *)EEPROM_RESET_STATS_OFFSET, EEPROM_RESET_STATS_SIZE);
+    ee_read_block(&reset_stats, EEPROM_RESET_STATS_OFFSET, EEPROM_RESET_STATS_SIZE);
 
-    LOG_HEXDUMP_DBG(reset_stats, EEPROM_RESET_STATS_SIZE);
+    LOG_HEXDUMP_DBG(&reset_stats, EEPROM_RESET_STATS_SIZE);
 
-    return (reset_stats->size == EEPROM_RESET_STATS_SIZE) &&
-           (crc8((const uint8_t *)reset_stats, EEPROM_RESET_STATS_SIZE) == 0u);
+    return (reset_stats.size == EEPROM_RESET_STATS_SIZE) &&
+           (crc8((const uint8_t *)&reset_stats, EEPROM_RESET_STATS_SIZE) == 0u);
 }
 
-// Compute the checksum of the reset_stats struct and write it to EEPROM.
-static bool write_reset_stats(struct eeprom_reset_stats *reset_stats)
+// Compute the checksum of the RAM mirror and write it back to EEPROM if modified.
+static void write_reset_stats(void)
 {
-    reset_stats->size = EEPROM_RESET_STATS_SIZE;
-    reset_stats->checksum =
-        crc8((const uint8_t *)reset_stats, EEPROM_RESET_STATS_SIZE - 1u);
+    if (reset_stats_dirty) {
+        reset_stats.size = EEPROM_RESET_STATS_SIZE;
+        reset_stats.checksum =
+            crc8((const uint8_t *)&reset_stats, EEPROM_RESET_STATS_SIZE - 1u);
 
-    eeprom_update_block(
-        reset_stats, (void *)EEPROM_RESET_STATS_OFFSET, EEPROM_RESET_STATS_SIZE);
+        /* only the modified bytes are actually written */
+        ee_update_block(&reset_stats, EEPROM_RESET_STATS_OFFSET, EEPROM_RESET_STATS_SIZE);
 
-    return true;
+        reset_stats_dirty = false;
+    }
 }
 
 bool diag_reset_stats_eeprom_clear(void)
 {
-    struct eeprom_reset_stats reset_stats;
     memset(&reset_stats, 0u, sizeof(reset_stats));
-    return write_reset_stats(&reset_stats);
+    reset_stats_dirty = true;
+    write_reset_stats();
+
+    return true;
 }
 
 uint16_t diag_reset_get_count_by_reason(diag_reset_reason_t reason)
 {
     uint16_t count = 0u;
 
-    DIAG_LOCK();
-    DIAG_DECLARE_RAMBUF();
-    struct eeprom_reset_stats *p_reset_stats = DIAG_GET_RAMBUF_PTR();
-    if (reason < PLATFORM_RESET_REASON_COUNT && read_reset_stats(p_reset_stats)) {
-        count = p_reset_stats->counter[reason];
+    if (reason < PLATFORM_RESET_REASON_COUNT) {
+        count = reset_stats.counter[reason];
     }
 
-    DIAG_UNLOCK();
-
     return count;
 }
 
@@ -185,43 +165,27 @@ uint16_t diag_reset_get_count(void)
 {
     uint16_t count = 0u;
 
-    DIAG_LOCK();
-    DIAG_DECLARE_RAMBUF();
-    struct eeprom_reset_stats *p_reset_stats = DIAG_GET_RAMBUF_PTR();
-    if (read_reset_stats(p_reset_stats)) {
-        for (uint8_t i = 0u; i < PLATFORM_RESET_REASON_COUNT; i++) {
-            count += p_reset_stats->counter[i];
-        }
+    for (uint8_t i = 0u; i < PLATFORM_RESET_REASON_COUNT; i++) {
+        count += reset_stats.counter[i];
     }
 
-    DIAG_UNLOCK();
-
     return count;
 }
 
 int8_t diag_reset_count_clear_bm(uint8_t reason_flags)
 {
-    int8_t ret = -EIO;
-
     reason_flags &= BIT(PLATFORM_RESET_REASON_COUNT) - 1u;
 
-    DIAG_LOCK();
-    DIAG_DECLARE_RAMBUF();
-    struct eeprom_reset_stats *p_reset_stats = DIAG_GET_RAMBUF_PTR();
-
-    if (read_reset_stats(p_reset_stats)) {
-        for (uint8_t i = 0u; i < PLATFORM_RESET_REASON_COUNT; i++) {
-            if (reason_flags & BIT(i)) {
-                p_reset_stats->counter[i] = 0u;
-            }
+    for (uint8_t i = 0u; i < PLATFORM_RESET_REASON_COUNT; i++) {
+        if ((reason_flags & BIT(i)) && (reset_stats.counter[i] != 0u)) {
+            reset_stats.counter[i] = 0u;
+            reset_stats_dirty      = true;
         }
-
-        if (write_reset_stats(p_reset_stats)) ret = 0;
     }
 
-    DIAG_UNLOCK();
+    write_reset_stats();
 
-    return ret;
+    return 0;
 }
 
 #if CONFIG_DIAG_RESET_CONTEXT_HISTORY
@@ -324,37 +288,29 @@ static int8_t diag_reset_stats_init_update(void)
     /* Function should be called only once */
     if (diag_reset_context_initialized) return -EAGAIN;
 
-    int8_t ret = -EIO;
-
-    DIAG_LOCK();
-    DIAG_DECLARE_RAMBUF();
-    struct eeprom_reset_stats *p_reset_stats = DIAG_GET_RAMBUF_PTR();
-
-    if (read_reset_stats(p_reset_stats) == false) {
+    if (read_reset_stats() == false) {
         /* Failed to read EEPROM, initialize reset_stats and write the to EEPROM */
-        memset(p_reset_stats, 0u, sizeof(*p_reset_stats));
+        memset(&reset_stats, 0u, sizeof(reset_stats));
     }
 
     diag_reset_reason_t last_reason = diag_reset_get_reason();
 
     /* Increment the counter corresponding to the last reset reason */
-    p_reset_stats->counter[last_reason]++;
+    reset_stats.counter[last_reason]++;
 
 #if CONFIG_DIAG_RESET_CONTEXT_HISTORY
     struct diag_reset_context ctx = {0u};
     if (get_previous_run_context(&ctx) == true) {
-        reset_context_save(p_reset_stats->contexts, &ctx);
+        reset_context_save(reset_stats.contexts, &ctx);
     }
 #endif // CONFIG_DIAG_RESET_CONTEXT_HISTORY
 
-    if (write_reset_stats(p_reset_stats)) {
-        ret                            = 0;
-        diag_reset_context_initialized = true;
-    }
+    reset_stats_dirty = true;
+    write_reset_stats();
 
-    DIAG_UNLOCK();
+    diag_reset_context_initialized = true;
 
-    return ret;
+    return 0;
 }
 #endif // CONFIG_DIAG_RESET_CONTEXT_PERSISTENT
 
@@ -384,17 +340,10 @@ diag_reset_reason_t diag_reset_get_last_reason(uint8_t ago)
         reason = diag_reset_get_reason();
     } else {
 #if CONFIG_DIAG_RESET_CONTEXT_HISTORY
-        DIAG_LOCK();
-        DIAG_DECLARE_RAMBUF();
-        struct eeprom_reset_stats *p_reset_stats = DIAG_GET_RAMBUF_PTR();
-        if (read_reset_stats(p_reset_stats)) {
-            struct diag_reset_context *ctx =
-                reset_context_read_last(p_reset_stats->contexts, ago);
-            if (ctx != NULL) {
-                reason = ctx->reset_reason;
-            }
+        struct diag_reset_context *ctx = reset_context_read_last(reset_stats.contexts, ago);
+        if (ctx != NULL) {
+            reason = ctx->reset_reason;
         }
-        DIAG_UNLOCK();
 #endif // CONFIG_DIAG_RESET_CONTEXT_HISTORY
     }
 
@@ -426,22 +375,14 @@ int8_t diag_reset_context_get_last(uint8_t ago, struct diag_reset_context *ctx)
         ret                             = 0u;
     } else {
 #if CONFIG_DIAG_RESET_CONTEXT_HISTORY
-        DIAG_LOCK();
-        DIAG_DECLARE_RAMBUF();
-        struct eeprom_reset_stats *p_reset_stats = DIAG_GET_RAMBUF_PTR();
-        if (read_reset_stats(p_reset_stats)) {
-            struct diag_reset_context *ref_ctx =
-                reset_context_read_last(p_reset_stats->contexts, ago);
-            if (ref_ctx != NULL) {
-                memcpy(ctx, ref_ctx, sizeof(*ctx));
-                ret = 0;
-            } else {
-                ret = -ENOENT;
-            }
+        struct diag_reset_context *ref_ctx =
+            reset_context_read_last(reset_stats.contexts, ago);
+        if (ref_ctx != NULL) {
+            memcpy(ctx, ref_ctx, sizeof(*ctx));
+            ret = 0;
         } else {
-            ret = -EIO;
+            ret = -ENOENT;
         }
-        DIAG_UNLOCK();
 #else
         ret = -ENOTSUP;
 #endif // CONFIG_DIAG_RESET_CONTEXT_HISTORY
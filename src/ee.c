@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2024 Lucas Dietrich <ld.adecy@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "ee.h"
+#include "metrics.h"
+
+#if CONFIG_EEPROM_WRITE_BEHIND
+
+#include <stdbool.h>
+
+#include <avrtos/avrtos.h>
+
+#include <avr/eeprom.h>
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+
+#define QUEUE_MASK (CONFIG_EEPROM_WRITE_BEHIND_QUEUE_SIZE - 1u)
+
+#if (CONFIG_EEPROM_WRITE_BEHIND_QUEUE_SIZE & QUEUE_MASK) != 0u ||                        \
+    CONFIG_EEPROM_WRITE_BEHIND_QUEUE_SIZE > 128u
+#error "CONFIG_EEPROM_WRITE_BEHIND_QUEUE_SIZE must be a power of 2 <= 128"
+#endif
+
+struct ee_byte {
+    uint16_t addr;
+    uint8_t data;
+};
+
+static struct {
+    struct ee_byte queue[CONFIG_EEPROM_WRITE_BEHIND_QUEUE_SIZE];
+
+    /* Next byte to program (ISR) */
+    volatile uint8_t head;
+
+    /* Next free slot (thread) */
+    volatile uint8_t tail;
+} ee;
+
+static inline uint8_t queue_count(void)
+{
+    return (uint8_t)(ee.tail - ee.head);
+}
+
+/* Start programming the next queued byte differing from the EEPROM content,
+ * the EEPROM must be ready. Return false if there is none.
+ */
+static bool program_next(void)
+{
+    while (ee.head != ee.tail) {
+        const struct ee_byte b = ee.queue[ee.head & QUEUE_MASK];
+
+        ee.head++;
+
+        EEAR = b.addr;
+        EECR |= BIT(EERE);
+
+        if (EEDR != b.data) {
+            EEDR = b.data;
+            EECR |= BIT(EEMPE);
+            EECR |= BIT(EEPE);
+            metrics_inc(METRICS_EEPROM_WRITE);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+ISR(EE_READY_vect)
+{
+    if (!program_next()) {
+        EECR &= ~BIT(EERIE);
+    }
+}
+
+void ee_update_byte(uint16_t addr, uint8_t value)
+{
+    for (;;) {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            if (queue_count() < CONFIG_EEPROM_WRITE_BEHIND_QUEUE_SIZE) {
+                ee.queue[ee.tail & QUEUE_MASK] = (struct ee_byte){addr, value};
+                ee.tail++;
+                EECR |= BIT(EERIE);
+                return;
+            }
+        }
+
+        /* Queue full, a slot is freed every ~3.4 ms. Don't sleep, this is
+         * also used during the initialization with the scheduler locked.
+         */
+        k_yield();
+    }
+}
+
+void ee_update_block(const void *src, uint16_t addr, size_t len)
+{
+    const uint8_t *p = src;
+
+    while (len--) {
+        ee_update_byte(addr++, *p++);
+    }
+}
+
+void ee_read_block(void *dst, uint16_t addr, size_t len)
+{
+    uint8_t *const buf = dst;
+    uint8_t eerie;
+
+    /* Prevent the ISR from starting a new write while reading */
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        eerie = EECR & BIT(EERIE);
+        EECR &= ~BIT(EERIE);
+    }
+
+    eeprom_read_block(dst, (const void *)addr, len);
+
+    /* Bytes not programmed yet, oldest first so that the last write wins */
+    for (uint8_t i = ee.head; i != ee.tail; i++) {
+        const struct ee_byte *const b = &ee.queue[i & QUEUE_MASK];
+
+        if ((uint16_t)(b->addr - addr) < len) {
+            buf[b->addr - addr] = b->data;
+        }
+    }
+
+    if (eerie) {
+        EECR |= BIT(EERIE);
+    }
+}
+
+uint8_t ee_read_byte(uint16_t addr)
+{
+    uint8_t value;
+
+    ee_read_block(&value, addr, 1u);
+
+    return value;
+}
+
+void ee_flush_sync(void)
+{
+    EECR &= ~BIT(EERIE);
+
+    do {
+        eeprom_busy_wait();
+    } while (program_next());
+
+    eeprom_busy_wait();
+}
+
+#endif /* CONFIG_EEPROM_WRITE_BEHIND */
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2024 Lucas Dietrich <ld.adecy@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @brief EEPROM access with write-behind.
+ *
+ * Writes are queued and programmed byte per byte from the EE_READY interrupt
+ * (update semantics: bytes already holding the value are skipped), in the
+ * order they were queued. Reads see the queued bytes. All EEPROM accesses
+ * must go through this API.
+ */
+
+#ifndef _CANIOT_DEV_EE_H_
+#define _CANIOT_DEV_EE_H_
+
+#include "config.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <avr/eeprom.h>
+#include <avrtos/avrtos.h>
+#include <caniot/device.h>
+
+/* EEPROM layout, regions follow each other in this order
+ *
+ *   Settings blocks, one per instance (settings.c)
+ *   Reset statistics (diag.c)
+ *   OneWire ROM cache (ow_ds_meas.c)
+ *   Settings journal up to E2END, one partition per instance (settings.c)
+ */
+#define EEPROM_SETTINGS_BLOCK_SIZE     (sizeof(struct caniot_device_config) + 1u)
+#define EEPROM_SETTINGS_OFFSET         0u
+#define EEPROM_SETTINGS_SIZE           (EEPROM_SETTINGS_BLOCK_SIZE * CONFIG_DEVICE_INSTANCES_COUNT)
+#define EEPROM_RESET_STATS_OFFSET      (EEPROM_SETTINGS_OFFSET + EEPROM_SETTINGS_SIZE)
+#define EEPROM_RESET_STATS_MAX_SIZE    64u
+#define EEPROM_OW_ROM_CACHE_OFFSET     (EEPROM_RESET_STATS_OFFSET + EEPROM_RESET_STATS_MAX_SIZE)
+#define EEPROM_OW_ROM_CACHE_MAX_SIZE   32u
+#define EEPROM_SETTINGS_JOURNAL_OFFSET (EEPROM_OW_ROM_CACHE_OFFSET + EEPROM_OW_ROM_CACHE_MAX_SIZE)
+
+/* The settings size is only known to the compiler */
+__STATIC_ASSERT(EEPROM_SETTINGS_JOURNAL_OFFSET <= E2END + 1u, "EEPROM layout too large");
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if CONFIG_EEPROM_WRITE_BEHIND
+
+/**
+ * @brief Queue a block for writing, wait (thread context) for room in the
+ * queue if needed.
+ *
+ * @param src
+ * @param addr EEPROM address
+ * @param len
+ */
+void ee_update_block(const void *src, uint16_t addr, size_t len);
+
+void ee_update_byte(uint16_t addr, uint8_t value);
+
+/**
+ * @brief Read a block, including the bytes not programmed yet
+ *
+ * @param dst
+ * @param addr EEPROM address
+ * @param len
+ */
+void ee_read_block(void *dst, uint16_t addr, size_t len);
+
+uint8_t ee_read_byte(uint16_t addr);
+
+/**
+ * @brief Program all the queued bytes by busy-waiting, to be used with
+ * interrupts disabled (e.g. before a reset).
+ */
+void ee_flush_sync(void);
+
+#else
+
+static inline void ee_update_block(const void *src, uint16_t addr, size_t len)
+{
+    eeprom_update_block(src, (void *)addr, len);
+}
+
+static inline void ee_update_byte(uint16_t addr, uint8_t value)
+{
+    eeprom_update_byte((uint8_t *)addr, value);
+}
+
+static inline void ee_read_block(void *dst, uint16_t addr, size_t len)
+{
+    eeprom_read_block(dst, (const void *)addr, len);
+}
+
+static inline uint8_t ee_read_byte(uint16_t addr)
+{
+    return eeprom_read_byte((const uint8_t *)addr);
+}
+
+static inline void ee_flush_sync(void)
+{
+}
+
+#endif /* CONFIG_EEPROM_WRITE_BEHIND */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CANIOT_DEV_EE_H_ */
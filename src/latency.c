@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2024 Lucas Dietrich <ld.adecy@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @brief latency.c Measure the CAN request -> response latency on target.
+ *
+ * The latency is the time elapsed between the MCP2515 interrupt (frame
+ * received) and the next frame being handed to mcp2515_send(). Timestamps
+ * are built from the kernel uptime (ms) and the sysclock timer counter,
+ * giving a resolution of one timer 2 prescaler period (64 cycles at 16 MHz).
+ *
+ * Samples are accumulated in a linear histogram, p50/p99 are reported as the
+ * upper bound of the matching bucket, max is exact. Samples beyond the last
+ * bucket (e.g. frame received but never answered) are only counted as overflows.
+ */
+
+#include "latency.h"
+
+#if CONFIG_CAN_LATENCY_TRACE
+
+#include <stdio.h>
+#include <string.h>
+
+#include <avrtos/avrtos.h>
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
+
+#if (CONFIG_KERNEL_SYSLOCK_HW_TIMER != 2) || (CONFIG_KERNEL_SYSCLOCK_PERIOD_US != 1000)
+#error "CAN latency trace requires the 1 ms sysclock on timer 2"
+#endif
+
+#define CYCLES_PER_MS (F_CPU / 1000lu)
+
+static const uint16_t timer2_prescalers[8u] PROGMEM = {0u, 1u, 8u, 32u, 64u, 128u, 256u, 1024u};
+
+struct latency_stats {
+    uint32_t max;
+    uint16_t count;
+    uint16_t overflows;
+    uint16_t buckets[CONFIG_CAN_LATENCY_BUCKETS_COUNT];
+};
+
+static struct {
+    uint32_t start;
+    uint8_t armed;
+    struct latency_stats stats;
+} lat;
+
+/* Copy of the statistics being printed, not on the stack as the dump is
+ * called from the shell thread.
+ */
+static struct latency_stats snapshot;
+
+/* Must be called with interrupts disabled */
+static uint32_t cycles_now(void)
+{
+    uint32_t ms    = k_uptime_get_ms32();
+    uint8_t cnt    = TCNT2;
+    uint16_t presc = pgm_read_word(&timer2_prescalers[TCCR2B & 0x07u]);
+
+    /* Compare match occurred but the tick has not been accounted yet */
+    if ((TIFR2 & BIT(OCF2A)) && (cnt < (OCR2A >> 1u))) {
+        ms++;
+    }
+
+    return ms * CYCLES_PER_MS + (uint32_t)cnt * presc;
+}
+
+void latency_rx_mark(void)
+{
+    if (!lat.armed) {
+        lat.start = cycles_now();
+        lat.armed = 1u;
+    }
+}
+
+void latency_tx_mark(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (lat.armed) {
+            const uint32_t delta = cycles_now() - lat.start;
+            const uint32_t index = delta / CONFIG_CAN_LATENCY_BUCKET_CYCLES;
+
+            lat.armed = 0u;
+
+            if (index < CONFIG_CAN_LATENCY_BUCKETS_COUNT) {
+                lat.stats.buckets[index]++;
+                lat.stats.count++;
+                lat.stats.max = MAX(lat.stats.max, delta);
+            } else {
+                lat.stats.overflows++;
+            }
+        }
+    }
+}
+
+static uint32_t percentile(const struct latency_stats *stats, uint8_t p)
+{
+    const uint32_t threshold = ((uint32_t)stats->count * p + 99u) / 100u;
+    uint32_t sum             = 0u;
+
+    for (uint8_t i = 0u; i < CONFIG_CAN_LATENCY_BUCKETS_COUNT; i++) {
+        sum += stats->buckets[i];
+        if (sum >= threshold) {
+            return (uint32_t)(i + 1u) * CONFIG_CAN_LATENCY_BUCKET_CYCLES;
+        }
+    }
+
+    return 0u;
+}
+
+void latency_dump(void)
+{
+    /* Snapshot and reset the statistics at once, so that the printed figures
+     * are consistent and no sample is lost in between.
+     */
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        memcpy(&snapshot, &lat.stats, sizeof(snapshot));
+        memset(&lat.stats, 0x00u, sizeof(lat.stats));
+    }
+
+    printf_P(PSTR("lat n=%u p50<=%lu p99<=%lu max=%lu ovf=%u (cycles)\n"),
+             snapshot.count,
+             snapshot.count ? percentile(&snapshot, 50u) : 0lu,
+             snapshot.count ? percentile(&snapshot, 99u) : 0lu,
+             snapshot.max,
+             snapshot.overflows);
+}
+
+#endif /* CONFIG_CAN_LATENCY_TRACE */
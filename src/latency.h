@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2024 Lucas Dietrich <ld.adecy@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _CANIOT_DEV_LATENCY_H_
+#define _CANIOT_DEV_LATENCY_H_
+
+#include <stdint.h>
+
+#include <avrtos/avrtos.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if CONFIG_CAN_LATENCY_TRACE
+
+/**
+ * @brief Mark the reception of a CAN frame (MCP2515 INT falling edge)
+ *
+ * Must be called from the CAN interrupt handler. Only the first interrupt
+ * following a response is taken into account.
+ */
+void latency_rx_mark(void);
+
+/**
+ * @brief Mark a frame being handed to the MCP2515 for transmission
+ *
+ * Record the time elapsed since the last latency_rx_mark() call, if any.
+ */
+void latency_tx_mark(void);
+
+/**
+ * @brief Print p50/p99/max latency (in CPU cycles) and reset the statistics
+ */
+void latency_dump(void);
+
+#else
+
+static inline void latency_rx_mark(void)
+{
+}
+
+static inline void latency_tx_mark(void)
+{
+}
+
+#endif /* CONFIG_CAN_LATENCY_TRACE */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CANIOT_DEV_LATENCY_H_ */
@@ -8,9 +8,11 @@
 #include "can.h"
 #include "config.h"
 #include "dev.h"
-#include "devices/gpio_pulse.h"
 #include "devices/temp.h"
 #include "diag.h"
+#include "metrics.h"
+#include "onchange.h"
+#include "power.h"
 #include "shell.h"
 #include "watchdog.h"
 
@@ -46,6 +48,16 @@ const uint32_t max_process_interval =
 
 K_KERNEL_LINK_INIT();
 
+static inline bool deadline_reached(uint32_t deadline, uint32_t now)
+{
+    return (int32_t)(now - deadline) >= 0;
+}
+
+static inline uint32_t deadline_remaining(uint32_t deadline, uint32_t now)
+{
+    return deadline_reached(deadline, now) ? 0u : deadline - now;
+}
+
 int main(void)
 {
     /* Main thread watchdog id */
@@ -58,8 +70,15 @@ int main(void)
      */
     __ASSERT_SCHED_LOCKED();
 
+    /* Before the board enables the input change interrupts */
+    onchange_init();
+
     bsp_init();
 
+    power_init();
+
+    metrics_init();
+
 #if LOG_LEVEL >= LOG_LEVEL_DBG
     k_thread_dump_all();
     k_dump_stack_canaries();
@@ -71,9 +90,6 @@ int main(void)
 
     temp_start();
 
-#if CONFIG_GPIO_PULSE_SUPPORT
-    pulse_init();
-#endif
     can_init();
 
     dev_init();
@@ -99,45 +115,58 @@ int main(void)
     /* LOG */
     dev_print_indentification();
 
+    uint32_t now          = k_uptime_get_ms32();
+    uint32_t app_deadline = now;
+    uint32_t dev_deadline = now;
+
     for (;;) {
         /* Estimate time to next event :
-         * - Thread alive (for watchdog timeout)
+         * - Application process (also bounds the thread alive interval for watchdog)
          * - Caniot telemetry
-         * - Pulse event
          */
-        uint32_t timeout_ms = MIN(max_process_interval, dev_get_process_timeout());
-
-#if CONFIG_GPIO_PULSE_SUPPORT
-        timeout_ms = MIN(timeout_ms, pulse_remaining());
-#endif
+        uint32_t timeout_ms =
+            MIN(deadline_remaining(app_deadline, now), deadline_remaining(dev_deadline, now));
 
         k_poll_signal(&dev_process_sig, K_MSEC(timeout_ms));
 
-        /* Clear the signal before application functions triggers it */
-        if (!dev_telemetry_is_requested()) {
-            K_SIGNAL_SET_UNREADY(&dev_process_sig);
-        }
+        /* Clear the signal before fetching the events, so that an event raised
+         * meanwhile wakes up the thread again.
+         */
+        K_SIGNAL_SET_UNREADY(&dev_process_sig);
+        uint8_t events = dev_events_take();
+
+        now = k_uptime_get_ms32();
 
 #if CONFIG_WATCHDOG
         /* I'm alive ! */
         alive(tid);
 #endif /* CONFIG_WATCHDOG */
 
-#if CONFIG_GPIO_PULSE_SUPPORT
-        const uint32_t now = k_uptime_get_ms32();
-        if (pulse_process(now) == true) {
-            dev_trigger_telemetry(CANIOT_ENDPOINT_BOARD_CONTROL);
-        }
-#endif
-
         /* Application specific processing before CANIOT process*/
-        app_process();
+        if (!CONFIG_APP_PROCESS_ON_DEADLINE || (events & DEV_EVENT_APP) ||
+            deadline_reached(app_deadline, now)) {
+            app_process();
+
+            now          = k_uptime_get_ms32();
+            app_deadline = now + max_process_interval;
+        }
 
 #if CONFIG_SHELL && !CONFIG_SHELL_WORKQ_OFFLOADED
         shell_process();
+
+        now = k_uptime_get_ms32();
 #endif
 
-        dev_process(tid);
+        /* Catch telemetry requested by the pulses or the application */
+        events |= dev_events_take();
+
+        if ((events & (DEV_EVENT_CAN | DEV_EVENT_TELEMETRY)) ||
+            deadline_reached(dev_deadline, now)) {
+            dev_process(tid);
+
+            now          = k_uptime_get_ms32();
+            dev_deadline = now + MIN(dev_get_process_timeout(), max_process_interval);
+        }
 
 #if CONFIG_DIAG && CONFIG_DIAG_RESET_CONTEXT_RUNTIME
         diag_reset_context_update(k_uptime_get());
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2024 Lucas Dietrich <ld.adecy@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @brief metrics.c Runtime counters exposed as CANIOT attributes.
+ *
+ * Counters are plain increments on the hot path. The idle time is sampled
+ * from the timer 2 compare B interrupt, half a tick after the sysclock
+ * compare A, so that the sample doesn't observe the thread switched in by the
+ * tick: a sample is idle if the CPU was sleeping in the power sleep thread.
+ * This costs one additional wake up per tick while idle.
+ */
+
+#include "metrics.h"
+
+#if CONFIG_METRICS
+
+#include <errno.h>
+#include <string.h>
+
+#include <avrtos/avrtos.h>
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+
+#define METRICS_IDLE_SAMPLING                                                            \
+    (CONFIG_POWER_IDLE_SLEEP && (CONFIG_KERNEL_SYSLOCK_HW_TIMER == 2))
+
+uint32_t z_metrics_counters[METRICS_COUNTERS_COUNT];
+
+#if METRICS_IDLE_SAMPLING
+extern struct k_thread sleep_thread;
+
+static struct {
+    uint32_t samples;
+    uint32_t idle;
+} idle;
+
+/* Halve the samples after ~70 min at 1 kHz, so that samples * 1000 doesn't
+ * overflow if not read.
+ */
+#define IDLE_SAMPLES_MAX 0x400000lu
+
+ISR(TIMER2_COMPB_vect)
+{
+    if (idle.samples >= IDLE_SAMPLES_MAX) {
+        idle.samples >>= 1u;
+        idle.idle >>= 1u;
+    }
+
+    idle.samples++;
+    if (k_thread_get_current() == &sleep_thread) {
+        idle.idle++;
+    }
+}
+#endif
+
+void metrics_init(void)
+{
+#if METRICS_IDLE_SAMPLING
+    /* Sample at half a tick from the sysclock compare A */
+    OCR2B = OCR2A >> 1u;
+    TIFR2 = BIT(OCF2B);
+    TIMSK2 |= BIT(OCIE2B);
+#endif
+}
+
+int metrics_read(uint8_t id, uint32_t *val)
+{
+    int ret = 0;
+
+    if (id < METRICS_COUNTERS_COUNT) {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            *val = z_metrics_counters[id];
+        }
+    } else if (id == METRICS_IDLE_PERMILLE) {
+#if METRICS_IDLE_SAMPLING
+        uint32_t samples, idle_samples;
+
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            samples      = idle.samples;
+            idle_samples = idle.idle;
+            idle.samples = 0u;
+            idle.idle    = 0u;
+        }
+
+        *val = samples ? (idle_samples * 1000lu) / samples : 0u;
+#else
+        ret = -ENOTSUP;
+#endif
+    } else {
+        ret = -ENOTSUP;
+    }
+
+    return ret;
+}
+
+void metrics_reset(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        memset(z_metrics_counters, 0x00u, sizeof(z_metrics_counters));
+#if METRICS_IDLE_SAMPLING
+        memset(&idle, 0x00u, sizeof(idle));
+#endif
+    }
+}
+
+#endif /* CONFIG_METRICS */
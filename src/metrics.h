@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2024 Lucas Dietrich <ld.adecy@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _CANIOT_DEV_METRICS_H_
+#define _CANIOT_DEV_METRICS_H_
+
+#include "config.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Metrics, the identifier is the part of the DEV_ATTR_KEY_METRICS
+ * attribute key.
+ */
+typedef enum metrics_id {
+    /* Interrupts */
+    METRICS_IRQ_CAN = 0u,
+    METRICS_IRQ_PCINT,
+    METRICS_IRQ_EXTIO,
+
+    /* CAN frames */
+    METRICS_CAN_RX,
+    METRICS_CAN_TX,
+    METRICS_CAN_TX_ERROR,
+    METRICS_CAN_TXQ_FULL,
+
+    /* EEPROM bytes programmed */
+    METRICS_EEPROM_WRITE,
+
+    /* Number of counters, must be last of the counters */
+    METRICS_COUNTERS_COUNT,
+
+    /* Idle time (per mille) since the previous read, requires
+     * CONFIG_POWER_IDLE_SLEEP
+     */
+    METRICS_IDLE_PERMILLE = METRICS_COUNTERS_COUNT,
+} metrics_id_t;
+
+#if CONFIG_METRICS
+
+extern uint32_t z_metrics_counters[METRICS_COUNTERS_COUNT];
+
+/**
+ * @brief Increment a counter, counters incremented from an ISR must not be
+ * incremented from a thread (and conversely), unless the increment is done
+ * with interrupts disabled.
+ */
+static inline void metrics_inc(metrics_id_t id)
+{
+    z_metrics_counters[id]++;
+}
+
+/**
+ * @brief Initialize the metrics (idle time sampling)
+ */
+void metrics_init(void);
+
+/**
+ * @brief Read a metric
+ *
+ * @param id
+ * @param val
+ * @return int 0 on success, -ENOTSUP if the metric is not available
+ */
+int metrics_read(uint8_t id, uint32_t *val);
+
+/**
+ * @brief Reset all the metrics
+ */
+void metrics_reset(void);
+
+#else
+
+static inline void metrics_inc(metrics_id_t id)
+{
+    (void)id;
+}
+
+static inline void metrics_init(void)
+{
+}
+
+#endif /* CONFIG_METRICS */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CANIOT_DEV_METRICS_H_ */
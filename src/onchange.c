@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2024 Lucas Dietrich <ld.adecy@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @brief onchange.c Telemetry on input change, with debouncing and rate limiting.
+ *
+ * The board control telemetry samples the inputs when it is built, so the
+ * engine only has to know that an input changed, not which one nor how many
+ * times: all edges seen during the hold-off window (contact bounces, PIR
+ * bursts) end up in a single frame reflecting the settled state.
+ *
+ * The window is not restarted by subsequent edges, an input toggling forever
+ * is still reported at most every CONFIG_TELEMETRY_ON_CHANGE_MIN_GAP_MS.
+ */
+
+#include "dev.h"
+#include "onchange.h"
+
+#include <avrtos/avrtos.h>
+#include <avrtos/logging.h>
+
+#include <util/atomic.h>
+
+#define K_MODULE K_MODULE_APPLICATION
+
+#if !CONFIG_KERNEL_EVENTS
+#error "Telemetry on change needs CONFIG_KERNEL_EVENTS to be set"
+#endif
+
+static struct {
+    struct k_event ev;
+    uint32_t last_ms;
+    uint8_t armed : 1;
+    uint8_t sent : 1;
+} onchange;
+
+/* Called from the sysclock ISR once the hold-off window elapsed */
+static void onchange_handler(struct k_event *ev)
+{
+    onchange.armed   = 0u;
+    onchange.sent    = 1u;
+    onchange.last_ms = k_uptime_get_ms32();
+
+    dev_trigger_telemetry(CANIOT_ENDPOINT_BOARD_CONTROL);
+}
+
+void onchange_init(void)
+{
+    k_event_init(&onchange.ev, onchange_handler);
+}
+
+void onchange_notify(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (!onchange.armed) {
+            uint32_t delay_ms = CONFIG_TELEMETRY_ON_CHANGE_HOLDOFF_MS;
+
+            if (onchange.sent) {
+                const uint32_t elapsed_ms = k_uptime_get_ms32() - onchange.last_ms;
+
+                if (elapsed_ms < CONFIG_TELEMETRY_ON_CHANGE_MIN_GAP_MS) {
+                    delay_ms =
+                        MAX(delay_ms, CONFIG_TELEMETRY_ON_CHANGE_MIN_GAP_MS - elapsed_ms);
+                }
+            }
+
+            onchange.armed = 1u;
+            k_event_schedule(&onchange.ev, K_MSEC(delay_ms));
+        }
+    }
+}
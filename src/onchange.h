@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2024 Lucas Dietrich <ld.adecy@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _CANIOT_DEV_ONCHANGE_H_
+#define _CANIOT_DEV_ONCHANGE_H_
+
+#include "config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Initialize the telemetry on change engine, must be called before
+ * input change interrupts are enabled.
+ */
+void onchange_init(void);
+
+/**
+ * @brief Notify a change of the inputs monitored for telemetry on change
+ *
+ * Can be called from an ISR. The board control telemetry is triggered once
+ * the hold-off delay following the first change has elapsed (and no sooner
+ * than the minimum gap after the previous one). A change notified after the
+ * telemetry has been triggered always leads to a new one, so the last state
+ * of the inputs is always reported.
+ */
+void onchange_notify(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CANIOT_DEV_ONCHANGE_H_ */
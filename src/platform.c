@@ -6,6 +6,7 @@
 
 #include "can.h"
 #include "config.h"
+#include "ee.h"
 #include "platform.h"
 #include "watchdog.h"
 
@@ -56,15 +57,36 @@ static void msg2caniot(struct caniot_frame *frame, const struct can_frame *msg)
     memcpy(frame->buf, msg->data, msg->len);
 }
 
+int platform_caniot_recv_peek_sid(uint8_t *sid)
+{
+    const struct can_frame *msg;
+
+    int ret = can_recv_peek(&msg);
+    if (ret == 0) {
+        *sid = caniot_canid_to_id(msg->id).sid;
+    } else if (ret == -EAGAIN) {
+        ret = -CANIOT_EAGAIN;
+    }
+
+    return ret;
+}
+
+void platform_caniot_recv_drop(void)
+{
+    can_recv_release();
+}
+
 int platform_caniot_recv(struct caniot_frame *frame)
 {
     int ret;
-    struct can_frame req;
+    const struct can_frame *msg;
 
-    ret = can_recv(&req);
+    /* Convert the frame directly from the CAN RX buffer */
+    ret = can_recv_peek(&msg);
     if (ret == 0) {
-        // can_print_msg(&req);
-        msg2caniot(frame, (const struct can_frame *)&req);
+        // can_print_msg(msg);
+        msg2caniot(frame, msg);
+        can_recv_release();
 
 #if LOG_LEVEL >= LOG_LEVEL_INF
         k_show_uptime();
@@ -81,31 +103,45 @@ int platform_caniot_recv(struct caniot_frame *frame)
 #if CONFIG_CAN_DELAYABLE_TX
 struct delayed_msg {
     struct k_event ev;
+    struct k_work work;
     struct can_frame msg;
 };
 
 /* Should be increased if "delayed message" feature is used */
 K_MEM_SLAB_DEFINE(dmsg_slab, sizeof(struct delayed_msg), CONFIG_CAN_DELAYABLE_TX_BUFFER);
 
-static void dmsg_handler(struct k_event *ev)
+static void dmsg_work_handler(struct k_work *work)
 {
-    struct delayed_msg *dmsg = CONTAINER_OF(ev, struct delayed_msg, ev);
+    struct delayed_msg *dmsg = CONTAINER_OF(work, struct delayed_msg, work);
 
     (void)can_txq_message(&dmsg->msg);
 
     k_mem_slab_free(&dmsg_slab, dmsg);
 }
+
+/* Called from the sysclock ISR, the TX queue is not ISR-safe */
+static void dmsg_handler(struct k_event *ev)
+{
+    struct delayed_msg *dmsg = CONTAINER_OF(ev, struct delayed_msg, ev);
+
+    k_system_workqueue_submit(&dmsg->work);
+}
 #endif
 
 int platform_caniot_send(const struct caniot_frame *frame, uint32_t delay_ms)
 {
     int ret;
     if (!CONFIG_CAN_DELAYABLE_TX || (delay_ms < KERNEL_TICK_PERIOD_MS)) {
-        struct can_frame msg;
-
-        caniot2msg(&msg, frame);
-
-        ret = can_txq_message(&msg);
+        /* Build the frame directly in the CAN TX queue */
+        struct can_frame *msg = can_txq_alloc();
+
+        if (msg) {
+            caniot2msg(msg, frame);
+            can_txq_commit(msg);
+            ret = 0;
+        } else {
+            ret = -ENOMEM;
+        }
     } else {
 #if CONFIG_CAN_DELAYABLE_TX
         struct delayed_msg *dmsg;
@@ -113,6 +149,7 @@ int platform_caniot_send(const struct caniot_frame *frame, uint32_t delay_ms)
         ret = k_mem_slab_alloc(&dmsg_slab, (void **)&dmsg, K_NO_WAIT);
         if (ret == 0) {
             caniot2msg(&dmsg->msg, frame);
+            k_work_init(&dmsg->work, dmsg_work_handler);
             k_event_init(&dmsg->ev, dmsg_handler);
             ret = k_event_schedule(&dmsg->ev, K_MSEC(delay_ms));
             if (ret != 0) {
@@ -150,6 +187,9 @@ static void reset_now(void)
 
     irq_disable();
 
+    /* Commit the pending EEPROM writes */
+    ee_flush_sync();
+
     for (;;) {
         /* wait for WDT reset */
     }
@@ -52,6 +52,20 @@ void platform_set_time(uint32_t sec);
  */
 int platform_caniot_recv(struct caniot_frame *frame);
 
+/**
+ * @brief Get the sub-identifier of the next received caniot frame without consuming it.
+ *
+ * @param sid Sub-identifier of the frame.
+ * @return int 0 on success, -CANIOT_EAGAIN if no frame is available, other negative value
+ * on error.
+ */
+int platform_caniot_recv_peek_sid(uint8_t *sid);
+
+/**
+ * @brief Discard the next received caniot frame.
+ */
+void platform_caniot_recv_drop(void);
+
 /**
  * @brief Platform specific function to send a caniot frame.
  *
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2024 Lucas Dietrich <ld.adecy@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @brief power.c Reduce the MCU power consumption while idle.
+ *
+ * - If CONFIG_POWER_ADC_UNUSED is enabled, the ADC and the analog comparator
+ *   are turned off (the board and the application must not use them).
+ * - If CONFIG_POWER_IDLE_SLEEP is enabled, a preemptive thread replaces the
+ *   kernel idle thread and puts the CPU in SLEEP_MODE_IDLE whenever no other
+ *   thread is ready. The CPU is woken up by any interrupt (sysclock tick, CAN,
+ *   PCINT, USART, ...).
+ *
+ * Deeper sleep modes (power-save, power-down) are not used: the kernel sysclock
+ * runs from the synchronous timer 2 which is stopped in these modes, and the
+ * uptime could not be resynchronized on wake up.
+ */
+
+#include "power.h"
+
+#include <avrtos/avrtos.h>
+
+#include <avr/io.h>
+#include <avr/power.h>
+#include <avr/sleep.h>
+
+#if CONFIG_POWER_IDLE_SLEEP
+
+#if CONFIG_KERNEL_THREAD_IDLE
+#error "CONFIG_POWER_IDLE_SLEEP replaces the kernel idle thread (CONFIG_KERNEL_THREAD_IDLE=0)"
+#endif
+
+static void sleep_entry(void *arg)
+{
+    (void)arg;
+
+    for (;;) {
+        sleep_cpu();
+    }
+}
+
+/* The stack must hold a full context (32 registers, SREG and return address)
+ * saved when the sysclock preempts the thread, on top of the frame of the
+ * interrupt being served (call-clobbered registers and the kernel calls).
+ */
+K_THREAD_DEFINE(sleep_thread,
+                sleep_entry,
+                CONFIG_POWER_SLEEP_THREAD_STACK_SIZE,
+                K_PREEMPTIVE,
+                NULL,
+                'z');
+
+#endif /* CONFIG_POWER_IDLE_SLEEP */
+
+void power_init(void)
+{
+#if CONFIG_POWER_ADC_UNUSED
+    /* Turn off the ADC before removing its clock */
+    ADCSRA &= ~BIT(ADEN);
+    power_adc_disable();
+
+    /* Analog comparator off */
+    ACSR |= BIT(ACD);
+#endif
+
+#if CONFIG_POWER_IDLE_SLEEP
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    sleep_enable();
+#endif
+}
@@ -0,0 +1,24 @@
+/*
+ * Copyright (c) 2024 Lucas Dietrich <ld.adecy@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _CANIOT_DEV_POWER_H_
+#define _CANIOT_DEV_POWER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Turn off unused MCU peripherals (CONFIG_POWER_ADC_UNUSED) and
+ * configure idle sleep (CONFIG_POWER_IDLE_SLEEP).
+ */
+void power_init(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CANIOT_DEV_POWER_H_ */
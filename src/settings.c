@@ -7,16 +7,17 @@
 #include "class/class.h"
 #include "config.h"
 #include "dev.h"
+#include "ee.h"
 #include "settings.h"
 #include "utils/crc.h"
 
 #include <stdint.h>
+#include <string.h>
 #include <time.h>
 
 #include <avrtos/avrtos.h>
 #include <avrtos/logging.h>
 
-#include <avr/eeprom.h>
 #include <avr/io.h>
 #include <caniot/caniot.h>
 #include <caniot/device.h>
@@ -25,16 +26,195 @@
 
 #define SETTINGS_CONFIG_SIZE sizeof(struct caniot_device_config)
 /* Configuration structure size + 1 byte for the checksum */
-#define SETTINGS_BLOCK_SIZE (SETTINGS_CONFIG_SIZE + 1u)
-
-__STATIC_ASSERT(SETTINGS_BLOCK_SIZE *CONFIG_DEVICE_INSTANCES_COUNT <= E2END,
-                "Not enough EEPROM space for the settings");
+#define SETTINGS_BLOCK_SIZE EEPROM_SETTINGS_BLOCK_SIZE
 
 static uint16_t eeprom_config_offset(struct caniot_device *dev)
 {
-    return dev_get_instance_index(dev) * SETTINGS_BLOCK_SIZE;
+    return EEPROM_SETTINGS_OFFSET + dev_get_instance_index(dev) * SETTINGS_BLOCK_SIZE;
+}
+
+#if CONFIG_SETTINGS_JOURNAL
+
+/*
+ * Each instance owns a partition of the journal region:
+ *
+ *   [MAGIC] [record] [record] ... [END]
+ *
+ * with records made of:
+ *
+ *   [len] [offset] [data: len bytes] [crc8]
+ *
+ * Records are replayed in order over the configuration block. The header
+ * byte of a record is written last, right after the end marker following
+ * it, so a record interrupted by a power loss is never part of the journal.
+ * When the block is rewritten, the journal is emptied first so that its
+ * records are never replayed over the new block.
+ */
+
+#define JOURNAL_MAGIC 0xA5u
+#define JOURNAL_END   0xFFu
+
+#define JOURNAL_PART_SIZE                                                                \
+    ((E2END + 1u - EEPROM_SETTINGS_JOURNAL_OFFSET) / CONFIG_DEVICE_INSTANCES_COUNT)
+
+/* len, offset and crc */
+#define RECORD_OVERHEAD 3u
+#define RECORD_MAX_SIZE (RECORD_OVERHEAD + CONFIG_SETTINGS_JOURNAL_CHUNK)
+
+__STATIC_ASSERT(SETTINGS_CONFIG_SIZE <= 256u, "Record offset must fit in a byte");
+__STATIC_ASSERT(CONFIG_SETTINGS_JOURNAL_CHUNK < JOURNAL_END, "Record length clashes with END");
+__STATIC_ASSERT(JOURNAL_PART_SIZE >= RECORD_MAX_SIZE + 2u, "Journal partition too small");
+
+/* Address of the end marker of each partition, 0 if not formatted */
+static uint16_t journal_tail[CONFIG_DEVICE_INSTANCES_COUNT];
+
+static uint16_t journal_start(uint8_t index)
+{
+    return EEPROM_SETTINGS_JOURNAL_OFFSET + index * JOURNAL_PART_SIZE;
+}
+
+/* Read the record at addr, return its size or 0 if there is no valid record */
+static uint8_t record_read(uint16_t addr, uint16_t end, uint8_t *rec)
+{
+    const uint8_t len = ee_read_byte(addr);
+
+    if ((len == 0u) || (len > CONFIG_SETTINGS_JOURNAL_CHUNK)) {
+        return 0u;
+    }
+
+    const uint8_t size = len + RECORD_OVERHEAD;
+
+    if (addr + size > end) {
+        return 0u;
+    }
+
+    ee_read_block(rec, addr, size);
+
+    if (((uint16_t)rec[1] + len > SETTINGS_CONFIG_SIZE) || (crc8(rec, size) != 0u)) {
+        return 0u;
+    }
+
+    return size;
+}
+
+/**
+ * @brief Apply the journal records of an instance to a window of the
+ * configuration
+ *
+ * @param index Instance index
+ * @param buf Configuration bytes from offset "from" ("count" bytes)
+ * @param from Offset of the window in the configuration
+ * @param count Size of the window
+ * @return uint16_t Address of the end of the journal, 0 if not formatted
+ */
+static uint16_t journal_replay(uint8_t index, uint8_t *buf, uint16_t from, uint16_t count)
+{
+    uint8_t rec[RECORD_MAX_SIZE];
+    uint16_t addr      = journal_start(index);
+    const uint16_t end = addr + JOURNAL_PART_SIZE;
+    uint8_t size;
+
+    if (ee_read_byte(addr) != JOURNAL_MAGIC) {
+        return 0u;
+    }
+
+    addr++;
+
+    while ((size = record_read(addr, end, rec)) != 0u) {
+        /* Part of the record within the window */
+        const uint16_t first = MAX(rec[1], from);
+        const uint16_t last  = MIN(rec[1] + rec[0], from + count);
+
+        if (first < last) {
+            memcpy(&buf[first - from], &rec[2u + first - rec[1]], last - first);
+        }
+
+        addr += size;
+    }
+
+    return addr;
 }
 
+static void journal_reset(uint8_t index)
+{
+    const uint16_t start = journal_start(index);
+
+    ee_update_byte(start + 1u, JOURNAL_END);
+    ee_update_byte(start, JOURNAL_MAGIC);
+
+    journal_tail[index] = start + 1u;
+}
+
+static int journal_append(uint8_t index, uint8_t offset, const uint8_t *data, uint8_t len)
+{
+    const uint8_t hdr[2u] = {len, offset};
+    const uint16_t addr   = journal_tail[index];
+    const uint8_t size    = len + RECORD_OVERHEAD;
+
+    /* Keep room for the end marker */
+    if (addr + size + 1u > journal_start(index) + JOURNAL_PART_SIZE) {
+        return -ENOSPC;
+    }
+
+    const uint8_t crc = crc8_update(crc8(hdr, sizeof(hdr)), data, len);
+
+    ee_update_byte(addr + size, JOURNAL_END);
+    ee_update_byte(addr + 1u, offset);
+    ee_update_block(data, addr + 2u, len);
+    ee_update_byte(addr + size - 1u, crc);
+    ee_update_byte(addr, len);
+
+    journal_tail[index] = addr + size;
+
+    return 0;
+}
+
+/**
+ * @brief Append the bytes of the configuration which differ from the stored
+ * ones, in records of up to CONFIG_SETTINGS_JOURNAL_CHUNK bytes.
+ *
+ * @return int 0 on success, -ENOSPC if the journal is full or not formatted
+ */
+static int journal_write(struct caniot_device *dev)
+{
+    const uint8_t index         = dev_get_instance_index(dev);
+    const uint8_t *const config = (const uint8_t *)dev->config;
+    uint8_t stored[CONFIG_SETTINGS_JOURNAL_CHUNK];
+
+    if (journal_tail[index] == 0u) {
+        return -ENOSPC;
+    }
+
+    for (uint16_t from = 0u; from < SETTINGS_CONFIG_SIZE;
+         from += CONFIG_SETTINGS_JOURNAL_CHUNK) {
+        const uint8_t count = MIN(CONFIG_SETTINGS_JOURNAL_CHUNK, SETTINGS_CONFIG_SIZE - from);
+        uint8_t first = count, last = 0u;
+
+        /* Stored window: block bytes with the journal replayed over them */
+        ee_read_block(stored, eeprom_config_offset(dev) + 1u + from, count);
+        journal_replay(index, stored, from, count);
+
+        for (uint8_t i = 0u; i < count; i++) {
+            if (stored[i] != config[from + i]) {
+                if (first == count) first = i;
+                last = i;
+            }
+        }
+
+        if (first != count) {
+            const int ret = journal_append(
+                index, from + first, &config[from + first], last - first + 1u);
+            if (ret != 0) {
+                return ret;
+            }
+        }
+    }
+
+    return 0;
+}
+
+#endif /* CONFIG_SETTINGS_JOURNAL */
+
 /* Tell whether the initial configuration needs to be applied or not */
 static bool init_config_to_apply = true;
 
@@ -60,10 +240,10 @@ int settings_read(struct caniot_device *dev)
 {
     (void)dev;
 
-    const void *config_base_offset = (void *)eeprom_config_offset(dev);
-    const uint8_t actual_checksum  = eeprom_read_byte(config_base_offset);
+    const uint16_t config_base_offset = eeprom_config_offset(dev);
+    const uint8_t actual_checksum     = ee_read_byte(config_base_offset);
 
-    eeprom_read_block(dev->config, config_base_offset + 1u, SETTINGS_CONFIG_SIZE);
+    ee_read_block(dev->config, config_base_offset + 1u, SETTINGS_CONFIG_SIZE);
 
     uint8_t calculated_checksum =
         crc8((const uint8_t *)dev->config, SETTINGS_CONFIG_SIZE);
@@ -72,21 +252,47 @@ int settings_read(struct caniot_device *dev)
         return -EINVAL;
     }
 
+#if CONFIG_SETTINGS_JOURNAL
+    const uint8_t index = dev_get_instance_index(dev);
+
+    journal_tail[index] =
+        journal_replay(index, (uint8_t *)dev->config, 0u, SETTINGS_CONFIG_SIZE);
+#endif
+
     return 0;
 }
 
-int settings_write(struct caniot_device *dev)
+/* Write the whole configuration block, the journal is emptied */
+static void settings_write_block(struct caniot_device *dev)
 {
     const uint16_t config_base_offset = eeprom_config_offset(dev);
-    eeprom_update_block((const void *)dev->config,
-                        (void *)(config_base_offset + 1u),
-                        SETTINGS_CONFIG_SIZE);
+
+#if CONFIG_SETTINGS_JOURNAL
+    /* Empty the journal before rewriting the block, so that a power loss in
+     * between can't replay the old records over the new block.
+     */
+    journal_reset(dev_get_instance_index(dev));
+#endif
+
+    ee_update_block((const void *)dev->config, config_base_offset + 1u, SETTINGS_CONFIG_SIZE);
 
     const uint8_t calculated_checksum =
         crc8((const uint8_t *)dev->config, SETTINGS_CONFIG_SIZE);
 
     /* Write checksum */
-    eeprom_update_byte((uint8_t *)config_base_offset, calculated_checksum);
+    ee_update_byte(config_base_offset, calculated_checksum);
+}
+
+int settings_write(struct caniot_device *dev)
+{
+#if CONFIG_SETTINGS_JOURNAL
+    if (journal_write(dev) != 0) {
+        LOG_DBG("Settings journal full, compacting");
+        settings_write_block(dev);
+    }
+#else
+    settings_write_block(dev);
+#endif
 
     return settings_apply(dev);
 }
@@ -96,7 +302,9 @@ int settings_restore_default(struct caniot_device *dev,
 {
     memcpy_P(dev->config, farp_default_config, SETTINGS_CONFIG_SIZE);
 
-    return settings_write(dev);
+    settings_write_block(dev);
+
+    return settings_apply(dev);
 }
 
 #if CONFIG_FORCE_RESTORE_DEFAULT_CONFIG
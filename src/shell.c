@@ -11,6 +11,8 @@
 #include "dev.h"
 #include "devices/heater.h"
 #include "diag.h"
+#include "ee.h"
+#include "latency.h"
 #include "platform.h"
 #include "shell.h"
 #include "utils/hexdump.h"
@@ -23,7 +25,6 @@
 #include <avrtos/drivers/usart.h>
 #include <avrtos/logging.h>
 
-#include <avr/eeprom.h>
 #include <caniot/caniot.h>
 #define LOG_LEVEL LOG_LEVEL_INF
 
@@ -87,12 +88,11 @@ static void dump_flash(void)
 
 static void dump_eeprom(void)
 {
-    uint8_t *ptr   = (uint8_t *)E2START;
-    uint8_t *end   = (uint8_t *)E2END + 1u;
+    uint16_t addr  = E2START;
     uint8_t offset = 0u;
 
-    while (ptr < end) {
-        hexdump_byte(offset++, eeprom_read_byte(ptr++));
+    while (addr <= E2END) {
+        hexdump_byte(offset++, ee_read_byte(addr++));
     }
 }
 
@@ -207,6 +207,12 @@ void shell_process(void)
         case 'l':
             stress_test_toggle();
             break;
+#endif
+#if CONFIG_CAN_LATENCY_TRACE
+        case 'b':
+        case 'B':
+            latency_dump();
+            break;
 #endif
         case 's':
         case 'S':
@@ -6,10 +6,78 @@
 
 #include "crc.h"
 
-uint8_t crc8(const uint8_t *buf, size_t len)
+#if CONFIG_CRC8_IMPL != CRC8_IMPL_BITWISE
+#include <avr/pgmspace.h>
+#endif
+
+#if CONFIG_CRC8_IMPL == CRC8_IMPL_TABLE
+
+/* CRC of each byte value (256 bytes of flash) */
+static const uint8_t crc8_table[256u] PROGMEM = {
+    0x00u, 0x31u, 0x62u, 0x53u, 0xc4u, 0xf5u, 0xa6u, 0x97u,
+    0xb9u, 0x88u, 0xdbu, 0xeau, 0x7du, 0x4cu, 0x1fu, 0x2eu,
+    0x43u, 0x72u, 0x21u, 0x10u, 0x87u, 0xb6u, 0xe5u, 0xd4u,
+    0xfau, 0xcbu, 0x98u, 0xa9u, 0x3eu, 0x0fu, 0x5cu, 0x6du,
+    0x86u, 0xb7u, 0xe4u, 0xd5u, 0x42u, 0x73u, 0x20u, 0x11u,
+    0x3fu, 0x0eu, 0x5du, 0x6cu, 0xfbu, 0xcau, 0x99u, 0xa8u,
+    0xc5u, 0xf4u, 0xa7u, 0x96u, 0x01u, 0x30u, 0x63u, 0x52u,
+    0x7cu, 0x4du, 0x1eu, 0x2fu, 0xb8u, 0x89u, 0xdau, 0xebu,
+    0x3du, 0x0cu, 0x5fu, 0x6eu, 0xf9u, 0xc8u, 0x9bu, 0xaau,
+    0x84u, 0xb5u, 0xe6u, 0xd7u, 0x40u, 0x71u, 0x22u, 0x13u,
+    0x7eu, 0x4fu, 0x1cu, 0x2du, 0xbau, 0x8bu, 0xd8u, 0xe9u,
+    0xc7u, 0xf6u, 0xa5u, 0x94u, 0x03u, 0x32u, 0x61u, 0x50u,
+    0xbbu, 0x8au, 0xd9u, 0xe8u, 0x7fu, 0x4eu, 0x1du, 0x2cu,
+    0x02u, 0x33u, 0x60u, 0x51u, 0xc6u, 0xf7u, 0xa4u, 0x95u,
+    0xf8u, 0xc9u, 0x9au, 0xabu, 0x3cu, 0x0du, 0x5eu, 0x6fu,
+    0x41u, 0x70u, 0x23u, 0x12u, 0x85u, 0xb4u, 0xe7u, 0xd6u,
+    0x7au, 0x4bu, 0x18u, 0x29u, 0xbeu, 0x8fu, 0xdcu, 0xedu,
+    0xc3u, 0xf2u, 0xa1u, 0x90u, 0x07u, 0x36u, 0x65u, 0x54u,
+    0x39u, 0x08u, 0x5bu, 0x6au, 0xfdu, 0xccu, 0x9fu, 0xaeu,
+    0x80u, 0xb1u, 0xe2u, 0xd3u, 0x44u, 0x75u, 0x26u, 0x17u,
+    0xfcu, 0xcdu, 0x9eu, 0xafu, 0x38u, 0x09u, 0x5au, 0x6bu,
+    0x45u, 0x74u, 0x27u, 0x16u, 0x81u, 0xb0u, 0xe3u, 0xd2u,
+    0xbfu, 0x8eu, 0xddu, 0xecu, 0x7bu, 0x4au, 0x19u, 0x28u,
+    0x06u, 0x37u, 0x64u, 0x55u, 0xc2u, 0xf3u, 0xa0u, 0x91u,
+    0x47u, 0x76u, 0x25u, 0x14u, 0x83u, 0xb2u, 0xe1u, 0xd0u,
+    0xfeu, 0xcfu, 0x9cu, 0xadu, 0x3au, 0x0bu, 0x58u, 0x69u,
+    0x04u, 0x35u, 0x66u, 0x57u, 0xc0u, 0xf1u, 0xa2u, 0x93u,
+    0xbdu, 0x8cu, 0xdfu, 0xeeu, 0x79u, 0x48u, 0x1bu, 0x2au,
+    0xc1u, 0xf0u, 0xa3u, 0x92u, 0x05u, 0x34u, 0x67u, 0x56u,
+    0x78u, 0x49u, 0x1au, 0x2bu, 0xbcu, 0x8du, 0xdeu, 0xefu,
+    0x82u, 0xb3u, 0xe0u, 0xd1u, 0x46u, 0x77u, 0x24u, 0x15u,
+    0x3bu, 0x0au, 0x59u, 0x68u, 0xffu, 0xceu, 0x9du, 0xacu,
+};
+
+uint8_t crc8_update(uint8_t crc, const uint8_t *buf, size_t len)
 {
-    uint8_t crc = 0xff;
+    while (len--) {
+        crc = pgm_read_byte(&crc8_table[crc ^ *buf++]);
+    }
+    return crc;
+}
+
+#elif CONFIG_CRC8_IMPL == CRC8_IMPL_NIBBLE
+
+/* CRC of each high nibble value (16 bytes of flash) */
+static const uint8_t crc8_table[16u] PROGMEM = {
+    0x00u, 0x31u, 0x62u, 0x53u, 0xc4u, 0xf5u, 0xa6u, 0x97u,
+    0xb9u, 0x88u, 0xdbu, 0xeau, 0x7du, 0x4cu, 0x1fu, 0x2eu,
+};
 
+uint8_t crc8_update(uint8_t crc, const uint8_t *buf, size_t len)
+{
+    while (len--) {
+        crc ^= *buf++;
+        crc = (uint8_t)(crc << 4) ^ pgm_read_byte(&crc8_table[crc >> 4]);
+        crc = (uint8_t)(crc << 4) ^ pgm_read_byte(&crc8_table[crc >> 4]);
+    }
+    return crc;
+}
+
+#else
+
+uint8_t crc8_update(uint8_t crc, const uint8_t *buf, size_t len)
+{
     while (len--) {
         crc ^= *buf++;
         for (uint8_t j = 0; j < 8; j++) {
@@ -20,4 +88,11 @@ uint8_t crc8(const uint8_t *buf, size_t len)
         }
     }
     return crc;
-}
\ No newline at end of file
+}
+
+#endif
+
+uint8_t crc8(const uint8_t *buf, size_t len)
+{
+    return crc8_update(CRC8_INIT, buf, len);
+}
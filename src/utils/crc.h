@@ -7,9 +7,14 @@
 #ifndef _CRC_H_
 #define _CRC_H_
 
+#include "config.h"
+
 #include <stddef.h>
 #include <stdint.h>
 
+/* CRC-8, polynomial 0x31, MSB first, no final XOR */
+#define CRC8_INIT 0xffu
+
 /**
  * @brief Compute CRC8 of a buffer.
  *
@@ -19,4 +24,17 @@
  */
 uint8_t crc8(const uint8_t *buf, size_t len);
 
-#endif /* _CRC_H_ */
\ No newline at end of file
+/**
+ * @brief Update a CRC8 with the content of a buffer, so that a CRC can be
+ * computed over several (non contiguous) buffers.
+ *
+ * crc8(buf, len) == crc8_update(CRC8_INIT, buf, len)
+ *
+ * @param crc CRC of the previous data, CRC8_INIT to start a new computation.
+ * @param buf
+ * @param len
+ * @return uint8_t Updated CRC8.
+ */
+uint8_t crc8_update(uint8_t crc, const uint8_t *buf, size_t len);
+
+#endif /* _CRC_H_ */